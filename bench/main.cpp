@@ -0,0 +1,476 @@
+#include "gmMachine.h"
+#include "gmMachinePool.h"
+#include "gmStreamBuffer.h"
+#include "gmThread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+
+// Each benchmark reproduces a workload that a change to GameMonkey was measured with, and prints the
+// best time over a number of runs. Build it from before and after a change to compare the two.
+
+typedef std::chrono::steady_clock::time_point BenchTime;
+
+static BenchTime now()
+{
+    return std::chrono::steady_clock::now();
+}
+
+static double secondsSince(BenchTime start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void printResult(const char* label, double seconds)
+{
+    printf("  %-48s %9.3f s\n", label, seconds);
+}
+
+static void printResultMilliseconds(const char* label, double seconds)
+{
+    printf("  %-48s %9.3f ms\n", label, seconds * 1000.0);
+}
+
+// Returns the best time over runs to compile source to a lib.
+static double timeCompile(const std::string& source, int runs, unsigned int& libSize)
+{
+    double best = 0.0;
+
+    for (int run = 0; run < runs; run++)
+    {
+        gmMachine machine;
+        gmStreamBufferDynamic stream;
+        BenchTime start = now();
+
+        if (machine.CompileStringToLib(source.c_str(), stream) != 0)
+        {
+            printf("  error: could not compile the script.\n");
+            return 0.0;
+        }
+
+        double seconds = secondsSince(start);
+        libSize = stream.GetSize();
+
+        if (run == 0 || seconds < best)
+        {
+            best = seconds;
+        }
+    }
+
+    return best;
+}
+
+// Compiles scripts with a large number of unique names and string constants to a lib, once as
+// table fields, which is dominated by finding duplicate strings in gmLibHooks, and once as locals,
+// which also has the code generator look up every variable.
+static void benchStrings(int runs)
+{
+    const int numStrings = 50000;
+    std::string fields = "t = table();\n";
+    std::string locals;
+    char line[64];
+    unsigned int libSize = 0;
+
+    for (int i = 0; i < numStrings; i++)
+    {
+        sprintf(line, "t.g%d = \"s%d_%x\";\n", i, i, i * 7919);
+        fields += line;
+        sprintf(line, "g%d = \"s%d_%x\";\n", i, i, i * 7919);
+        locals += line;
+    }
+
+    double seconds = timeCompile(fields, runs, libSize);
+    sprintf(line, "%d table fields, %u byte lib", numStrings, libSize);
+    printResult(line, seconds);
+
+    seconds = timeCompile(locals, runs, libSize);
+    sprintf(line, "%d locals, %u byte lib", numStrings, libSize);
+    printResult(line, seconds);
+}
+
+// Returns the best time over runs to execute a_call on machine.
+static double timeScript(gmMachine& machine, const char* call, int runs)
+{
+    double best = 0.0;
+
+    for (int run = 0; run < runs; run++)
+    {
+        BenchTime start = now();
+        machine.ExecuteString(call);
+        double seconds = secondsSince(start);
+
+        if (run == 0 || seconds < best)
+        {
+            best = seconds;
+        }
+    }
+
+    return best;
+}
+
+// Runs each script's run(n) function, which loops n times over a mix of byte codes. Build gmlib with
+// GMTHREAD_THREADEDDISPATCH set to 0 and to 1 to compare the two dispatch modes of Sys_Execute.
+static void benchDispatch(int runs)
+{
+    static const char* s_scripts[][2] =
+    {
+        { "int arithmetic and branches", "global run = function(n) { s = 0; for(i = 0; i < n; i += 1) { s = s + i * 3 - (i % 7); if(s > 100000) { s = s - 100000; } } return s; };" },
+        { "float arithmetic", "global run = function(n) { x = 0.5; y = 1.0; for(i = 0; i < n; i += 1) { x = x * 0.999 + y; y = y - x * 0.001; } return x; };" },
+        { "script calls", "global add = function(a, b) { return a + b; }; global run = function(n) { s = 0; for(i = 0; i < n; i += 1) { s = add(s, i); } return s; };" },
+        { "table get, set and dot", "global run = function(n) { t = table(); o = table(x = 1, y = 2); for(i = 0; i < n; i += 1) { t[i & 15] = i; o.x = o.x + t[(i + 3) & 15]; o.y = o.x - o.y; } return o.x; };" },
+        { "string compares", "global run = function(n) { s = 0; for(i = 0; i < n; i += 1) { if(\"ab\" == \"ab\") { s += 1; } } return s; };" },
+    };
+    const int numScripts = sizeof(s_scripts) / sizeof(s_scripts[0]);
+    const int iterations = 2000000;
+    char call[64];
+    double total = 0.0;
+
+    sprintf(call, "run(%d);", iterations);
+
+    for (int i = 0; i < numScripts; i++)
+    {
+        gmMachine machine;
+
+        if (machine.ExecuteString(s_scripts[i][1]) != 0)
+        {
+            printf("  error: could not compile the %s script.\n", s_scripts[i][0]);
+            return;
+        }
+
+        double seconds = timeScript(machine, call, runs);
+        total += seconds;
+        printResult(s_scripts[i][0], seconds);
+    }
+
+    printResult("total", total);
+}
+
+// Runs entity update scripts that use this.x style member access on tables of two layouts, and
+// member get and set on a single table.
+static void benchMembers(int runs)
+{
+    static const char* s_entities =
+        "global ents = table();"
+        "for(i = 0; i < 64; i += 1)"
+        "{"
+        "  if(i & 1) { ents[i] = table(x = 0.0, y = 0.0, vx = 1.0, vy = 0.5, hp = 100, state = 0); }"
+        "  else { ents[i] = table(state = 0, hp = 50, vy = 2.0, vx = 0.25, y = 1.0, x = 1.0, name = \"e\"); }"
+        "}"
+        "global update = function()"
+        "{"
+        "  .x = .x + .vx; .y = .y + .vy;"
+        "  if(.x > 100.0) { .vx = -.vx; .state = 1; } else if(.x < 0.0) { .vx = -.vx; .state = 0; }"
+        "  .hp = .hp - 1; if(.hp < 0) { .hp = 100; }"
+        "};"
+        "global run = function(n) { f = n / 64; for(k = 0; k < f; k += 1) { foreach(e in ents) { e:update(); } } };";
+    static const char* s_members =
+        "global run = function(n) { o = table(x = 1, y = 2, z = 3); for(i = 0; i < n; i += 1) { o.x = o.y + o.z; o.y = o.x - o.z; } return o.x; };";
+
+    gmMachine entityMachine;
+    gmMachine memberMachine;
+
+    if (entityMachine.ExecuteString(s_entities) != 0 || memberMachine.ExecuteString(s_members) != 0)
+    {
+        printf("  error: could not compile the scripts.\n");
+        return;
+    }
+
+    printResult("2000000 entity updates, 64 entities", timeScript(entityMachine, "run(2000000);", runs));
+    printResult("1000000 member gets and sets on one table", timeScript(memberMachine, "run(1000000);", runs));
+}
+
+// Runs script function calls and returns: recursion, a small helper called in a loop, recursion
+// 500 frames deep and method calls through a table member.
+static void benchCalls(int runs)
+{
+    static const char* s_scripts[][3] =
+    {
+        { "fib(30)", "global fib = function(n) { if(n < 2) { return n; } return fib(n - 1) + fib(n - 2); };", "fib(30);" },
+        { "3000000 helper calls", "global sq = function(a) { return a * a; }; global run = function(n) { s = 0; for(i = 0; i < n; i += 1) { s = s + sq(i & 7); } return s; };", "run(3000000);" },
+        { "6000 calls 500 deep", "global d = function(n) { if(n == 0) { return 0; } return 1 + d(n - 1); }; global run = function(n) { s = 0; for(i = 0; i < n; i += 1) { s = s + d(500); } return s; };", "run(6000);" },
+        { "3000000 method calls", "global o = table(v = 1); o.get = function() { return .v; }; global run = function(n) { s = 0; for(i = 0; i < n; i += 1) { s = s + o.get(); } return s; };", "run(3000000);" },
+    };
+    const int numScripts = sizeof(s_scripts) / sizeof(s_scripts[0]);
+
+    for (int i = 0; i < numScripts; i++)
+    {
+        gmMachine machine;
+
+        if (machine.ExecuteString(s_scripts[i][1]) != 0)
+        {
+            printf("  error: could not compile the %s script.\n", s_scripts[i][0]);
+            return;
+        }
+
+        printResult(s_scripts[i][0], timeScript(machine, s_scripts[i][2], runs));
+    }
+}
+
+// Runs frames of Execute(16) on many threads that loop on sleep() for 16 to 1920 milliseconds, so
+// that every frame wakes some of them and puts them back to sleep.
+static void benchSleep(int runs)
+{
+    static const int s_numThreads[] = { 10000, 100000 };
+    const int frames = 10;
+    char script[256];
+    char label[64];
+
+    for (int i = 0; i < (int) (sizeof(s_numThreads) / sizeof(s_numThreads[0])); i++)
+    {
+        double best = 0.0;
+
+        sprintf(script, "global ent = function(d) { while(true) { sleep(d); } };"
+            "for(i = 0; i < %d; i += 1) { thread(ent, 0.016 * (1 + (i * 7919) %% 120)); }", s_numThreads[i]);
+
+        for (int run = 0; run < runs; run++)
+        {
+            gmMachine machine;
+            machine.EnableGC(false);
+
+            if (machine.ExecuteString(script) != 0)
+            {
+                printf("  error: could not compile the script.\n");
+                return;
+            }
+
+            BenchTime start = now();
+
+            for (int frame = 0; frame < frames; frame++)
+            {
+                machine.Execute(16);
+            }
+
+            double seconds = secondsSince(start) / frames;
+
+            if (run == 0 || seconds < best)
+            {
+                best = seconds;
+            }
+        }
+
+        sprintf(label, "%d sleeping threads, per frame", s_numThreads[i]);
+        printResultMilliseconds(label, best);
+    }
+}
+
+static bool GM_CDECL initPoolMachine(gmMachine* machine, int, void* user)
+{
+    gmBindMachinePoolLib(machine);
+    return machine->ExecuteString((const char*) user, NULL, false) == 0;
+}
+
+// Runs a thread on every machine of a pool that does 8 loops of 200000 iterations, passing a message
+// around a ring of machines after each loop. Shows how work scales with the number of machines, and
+// what the per frame hand-off between machines costs.
+static void benchPool(int runs)
+{
+    static const char* s_script =
+        "global work = function()"
+        "{"
+        "  for(k = 0; k < 8; k += 1)"
+        "  {"
+        "    s = 0; for(i = 0; i < 200000; i += 1) { s = s + i * 3 - (i % 7); }"
+        "    machineSend((machineIndex() + 1) % machineCount(), s); m = machineReceive(); yield();"
+        "  }"
+        "};"
+        "thread(work);";
+    char label[64];
+
+    for (int numMachines = 1; numMachines <= 16; numMachines *= 2)
+    {
+        double best = 0.0;
+
+        for (int run = 0; run < runs; run++)
+        {
+            gmMachinePool pool;
+
+            if (!pool.Open(numMachines, initPoolMachine, (void*) s_script))
+            {
+                printf("  error: could not open a pool of %d machines.\n", numMachines);
+                return;
+            }
+
+            BenchTime start = now();
+
+            while (pool.Execute(1))
+            {
+            }
+
+            double seconds = secondsSince(start);
+
+            if (run == 0 || seconds < best)
+            {
+                best = seconds;
+            }
+        }
+
+        sprintf(label, "pool of %d, %.1f M loop iterations/s", numMachines, numMachines * 1.6 / best);
+        printResult(label, best);
+    }
+}
+
+// Runs frames on 50000 threads blocked on 1000 different signals: a frame with nothing signalled, a
+// frame after 20 signals that each wake 50 threads, and 1000 signals to single threads and a frame.
+static void benchSignals(int runs)
+{
+    const int numThreads = 50000;
+    const int numSignals = 1000;
+    char script[256];
+    int scriptThread = GM_INVALID_THREAD;
+    gmMachine machine;
+    double idle = 0.0;
+    double broadcast = 0.0;
+    double targeted = 0.0;
+
+    sprintf(script, "global w = function(k) { while(true) { block(k); } };"
+        "for(i = 0; i < %d; i += 1) { thread(w, i %% %d); }", numThreads, numSignals);
+
+    if (machine.ExecuteString(script, &scriptThread) != 0)
+    {
+        printf("  error: could not compile the script.\n");
+        return;
+    }
+
+    machine.Execute(1);
+
+    for (int run = 0; run < runs; run++)
+    {
+        BenchTime start = now();
+        machine.Execute(1);
+        double seconds = secondsSince(start);
+        idle = (run == 0 || seconds < idle) ? seconds : idle;
+
+        for (int i = 0; i < 20; i++)
+        {
+            machine.Signal(gmVariable(GM_INT, (run * 37 + i * 13) % numSignals), GM_INVALID_THREAD, GM_INVALID_THREAD);
+        }
+
+        start = now();
+        machine.Execute(1);
+        seconds = secondsSince(start);
+        broadcast = (run == 0 || seconds < broadcast) ? seconds : broadcast;
+
+        // the threads were created in order after the script thread, thread i blocking on i % numSignals
+        start = now();
+
+        for (int i = 0; i < numSignals; i++)
+        {
+            int thread = (run * 101 + i * 47) % numThreads;
+            machine.Signal(gmVariable(GM_INT, thread % numSignals), scriptThread + 1 + thread, GM_INVALID_THREAD);
+        }
+
+        machine.Execute(1);
+        seconds = secondsSince(start);
+        targeted = (run == 0 || seconds < targeted) ? seconds : targeted;
+    }
+
+    printResultMilliseconds("frame with nothing signalled", idle);
+    printResultMilliseconds("frame after 20 signals waking 1000 threads", broadcast);
+    printResultMilliseconds("1000 signals to single threads and a frame", targeted);
+}
+
+struct Benchmark
+{
+    const char* name;
+    const char* description;
+    void (*run)(int runs);
+};
+
+static const Benchmark s_benchmarks[] =
+{
+    { "strings", "compile scripts with 50000 unique strings to a lib", benchStrings },
+    { "dispatch", "run 2000000 iterations of five byte code mixes", benchDispatch },
+    { "members", "update entities through this.x style member access", benchMembers },
+    { "calls", "call and return from script functions", benchCalls },
+    { "sleep", "run frames of many threads that wake from sleep()", benchSleep },
+    { "pool", "run script loops on pools of 1 to 16 machines", benchPool },
+    { "signals", "signal threads blocked on many different signals", benchSignals },
+};
+
+static const int s_numBenchmarks = sizeof(s_benchmarks) / sizeof(s_benchmarks[0]);
+
+static void printUsage()
+{
+    printf("Usage:\n"
+        "  bench [-r <runs>] [<benchmark> ...]\n"
+        "Runs every benchmark when none are named, and prints the best time of each over 5 runs,\n"
+        "or the given number of runs.\n"
+        "Benchmarks:\n");
+
+    for (int i = 0; i < s_numBenchmarks; i++)
+    {
+        printf("  %-10s %s\n", s_benchmarks[i].name, s_benchmarks[i].description);
+    }
+}
+
+static bool runBenchmark(const char* name, int runs)
+{
+    for (int i = 0; i < s_numBenchmarks; i++)
+    {
+        if (strcmp(s_benchmarks[i].name, name) == 0)
+        {
+            printf("%s: %s\n", s_benchmarks[i].name, s_benchmarks[i].description);
+            s_benchmarks[i].run(runs);
+            return true;
+        }
+    }
+
+    printf("Error: unknown benchmark %s.\n", name);
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    int runs = 5;
+    int numNames = 0;
+
+    printf("GameMonkey benchmarks v1.0\n\n");
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "-r") == 0 && arg + 1 < argc)
+        {
+            runs = atoi(argv[++arg]);
+
+            if (runs <= 0)
+            {
+                printUsage();
+                return 1;
+            }
+        }
+        else if (argv[arg][0] == '-')
+        {
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            argv[numNames++] = argv[arg];
+        }
+    }
+
+    if (numNames == 0)
+    {
+        for (int i = 0; i < s_numBenchmarks; i++)
+        {
+            runBenchmark(s_benchmarks[i].name, runs);
+        }
+
+        return 0;
+    }
+
+    for (int i = 0; i < numNames; i++)
+    {
+        if (!runBenchmark(argv[i], runs))
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,298 @@
+#include "batch.h"
+#include "gmConfig.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+bool isDirectory(const char* path)
+{
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+bool makeDirectories(const std::string& path)
+{
+    for (size_t slash = path.find_first_of("/\\", 1); ; slash = path.find_first_of("/\\", slash + 1))
+    {
+        std::string dirpath = path.substr(0, slash);
+
+        if (!dirpath.empty() && !isDirectory(dirpath.c_str()))
+        {
+#ifdef _WIN32
+            CreateDirectoryA(dirpath.c_str(), NULL);
+#else
+            mkdir(dirpath.c_str(), 0777);
+#endif
+        }
+
+        if (slash == std::string::npos)
+        {
+            break;
+        }
+    }
+
+    return isDirectory(path.c_str());
+}
+
+void makeParentDirectories(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+
+    if (slash != std::string::npos && slash > 0)
+    {
+        makeDirectories(path.substr(0, slash));
+    }
+}
+
+bool hasExtension(const std::string& path, const char* ext)
+{
+    size_t len = strlen(ext);
+    return path.size() > len && _gmstricmp(path.c_str() + path.size() - len, ext) == 0;
+}
+
+std::string replaceExtension(const std::string& path, const char* ext)
+{
+    size_t slash = path.find_last_of("/\\");
+    size_t dot = path.find_last_of('.');
+
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    {
+        return path + ext;
+    }
+
+    return path.substr(0, dot) + ext;
+}
+
+bool isSafeEntryName(const std::string& name)
+{
+    if (name.empty() || name[0] == '/' || name[0] == '\\' || (name.size() > 1 && name[1] == ':'))
+    {
+        return false;
+    }
+
+    for (size_t start = 0; start <= name.size(); )
+    {
+        size_t end = name.find_first_of("/\\", start);
+
+        if (end == std::string::npos)
+        {
+            end = name.size();
+        }
+
+        if (name.compare(start, end - start, "..") == 0)
+        {
+            return false;
+        }
+
+        start = end + 1;
+    }
+
+    return true;
+}
+
+static void addJob(std::vector<BatchJob>& jobs, const std::string& inpath, const std::string& outpath,
+    const char* outext)
+{
+    BatchJob job;
+    job.inpath = inpath;
+    job.outpath = outpath.empty() ? replaceExtension(inpath, outext) : outpath;
+    jobs.push_back(job);
+}
+
+void findFiles(const std::string& dirpath, const char* ext, const char* outext, std::vector<BatchJob>& jobs)
+{
+#ifdef _WIN32
+    WIN32_FIND_DATAA findData;
+    HANDLE find = FindFirstFileA((dirpath + "\\*").c_str(), &findData);
+
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    do
+    {
+        std::string name = findData.cFileName;
+
+        if (name == "." || name == "..")
+        {
+            continue;
+        }
+
+        std::string path = dirpath + "\\" + name;
+
+        if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            findFiles(path, ext, outext, jobs);
+        }
+        else if (hasExtension(name, ext))
+        {
+            addJob(jobs, path, "", outext);
+        }
+    } while (FindNextFileA(find, &findData));
+
+    FindClose(find);
+#else
+    DIR* dir = opendir(dirpath.c_str());
+    struct dirent* entry;
+    struct stat info;
+
+    if (!dir)
+    {
+        return;
+    }
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        std::string name = entry->d_name;
+
+        if (name == "." || name == "..")
+        {
+            continue;
+        }
+
+        std::string path = dirpath + "/" + name;
+
+        if (stat(path.c_str(), &info) != 0)
+        {
+            continue;
+        }
+
+        if (S_ISDIR(info.st_mode))
+        {
+            findFiles(path, ext, outext, jobs);
+        }
+        else if (hasExtension(name, ext))
+        {
+            addJob(jobs, path, "", outext);
+        }
+    }
+
+    closedir(dir);
+#endif
+}
+
+bool readListFile(const char* listpath, const char* outext, std::vector<BatchJob>& jobs)
+{
+    FILE* listfile = fopen(listpath, "rb");
+    char line[GM_MAX_PATH * 2 + 2];
+
+    if (!listfile)
+    {
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), listfile))
+    {
+        size_t len = strlen(line);
+
+        while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        {
+            line[--len] = '\0';
+        }
+
+        if (len == 0 || line[0] == '#')
+        {
+            continue;
+        }
+
+        char* tab = strchr(line, '\t');
+
+        if (tab)
+        {
+            *tab = '\0';
+            addJob(jobs, line, tab + 1, outext);
+        }
+        else
+        {
+            addJob(jobs, line, "", outext);
+        }
+    }
+
+    fclose(listfile);
+    return true;
+}
+
+BatchResult runBatchJobs(int numJobs, int threadCount, const BatchFunction& job)
+{
+    BatchResult result;
+    std::atomic<int> nextJob(0);
+    std::atomic<int> failed(0);
+    std::atomic<unsigned long long> totalBytes(0);
+    std::mutex printLock;
+    std::vector<std::thread> workers;
+
+    if (threadCount > numJobs)
+    {
+        threadCount = numJobs;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        workers.push_back(std::thread([&, i]()
+        {
+            for (;;)
+            {
+                int index = nextJob++;
+
+                if (index >= numJobs)
+                {
+                    break;
+                }
+
+                std::string message;
+                unsigned int bytes = 0;
+
+                if (job(index, i, message, bytes))
+                {
+                    totalBytes += bytes;
+                }
+                else
+                {
+                    failed++;
+
+                    std::lock_guard<std::mutex> lock(printLock);
+                    printf("%s\n", message.c_str());
+                }
+            }
+        }));
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (result.seconds <= 0.0)
+    {
+        result.seconds = 1e-6;
+    }
+
+    result.threadCount = threadCount;
+    result.failed = failed;
+    result.totalBytes = totalBytes;
+    return result;
+}
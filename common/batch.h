@@ -0,0 +1,58 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Batch mode helpers shared by the compile and extract tools.
+
+struct BatchJob
+{
+    std::string inpath;
+    std::string outpath;
+};
+
+struct BatchResult
+{
+    int threadCount; //!< threads run, at most one per job
+    int failed;
+    unsigned long long totalBytes;
+    double seconds;
+};
+
+// Runs job index on worker thread, a number below the pool's thread count. Sets bytes to the
+// size of the data it processed, or returns false with message set to the text to print.
+typedef std::function<bool(int index, int thread, std::string& message, unsigned int& bytes)> BatchFunction;
+
+bool isDirectory(const char* path);
+
+// Creates the directory at path and any missing parent directories.
+bool makeDirectories(const std::string& path);
+
+// Creates the directories leading up to the file at path.
+void makeParentDirectories(const std::string& path);
+
+bool hasExtension(const std::string& path, const char* ext);
+
+// Returns path with its extension, if any, replaced by ext.
+std::string replaceExtension(const std::string& path, const char* ext);
+
+// A bundle entry name must stay below the directory it is unpacked into, so it may not be
+// absolute or have a ".." component.
+bool isSafeEntryName(const std::string& name);
+
+// Recursively collects every file with extension ext below dirpath, each to be written next to
+// itself with extension outext.
+void findFiles(const std::string& dirpath, const char* ext, const char* outext, std::vector<BatchJob>& jobs);
+
+// A list file holds one input path per line, optionally followed by a tab and the output path.
+// Blank lines and lines starting with '#' are skipped. Without an output path the input path
+// with extension outext is used.
+bool readListFile(const char* listpath, const char* outext, std::vector<BatchJob>& jobs);
+
+// Runs every job below numJobs on a pool of up to threadCount threads, printing the message of
+// each failed job as it happens.
+BatchResult runBatchJobs(int numJobs, int threadCount, const BatchFunction& job);
+
+#endif // _BATCH_H_
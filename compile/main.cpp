@@ -1,63 +1,488 @@
 #include "gmMachine.h"
+#include "gmByteCode.h"
+#include "gmCrc.h"
+#include "gmLibBundle.h"
 #include "gmLibHooks.h"
 #include "gmStreamBuffer.h"
+#include "batch.h"
 
 #include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <sys/utime.h>
+#undef GetObject
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+// Part of every cache key. Bump it whenever a change to the compiler changes the libs it writes,
+// so stale cache entries are never used.
+#define COMPILE_CACHE_VERSION "1"
 
 static void printUsage()
 {
     printf("Usage:\n"
-        "  compile [-g for gamecube] <input gm source file> <output gm lib file>");
+        "  compile [-g for gamecube] [-z to compress source] <input gm source file> <output gm lib file>\n"
+        "  compile [-g for gamecube] [-z to compress source] --batch <input directory or list file> [-j <thread count>]\n"
+        "          [--bundle <output gm lib bundle file>]\n"
+        "Options:\n"
+        "  --cache <cache directory>  reuse libs compiled from the same source\n"
+        "  --cache-size <megabytes>   trim the least recently used cache entries down to this size\n"
+        "  --sequences <count>        report the most frequent byte code sequences");
 }
 
-int main(int argc, char** argv)
+// On disk cache of compiled libs. Each entry is a lib named by a hash of its source text, the
+// target endian, the compile flags and the compiler version.
+struct CompileCache
 {
-    int rc = 1;
-    char* inpath = NULL;
-    char* outpath = NULL;
-    FILE* infile = NULL;
-    FILE* outfile = NULL;
-    int insize;
-    char* source = NULL;
-    gmMachine machine;
-    gmStreamBufferDynamic stream;
-    int outsize;
-    int errors;
+    std::string dirpath;
+    long long maxBytes; //!< trim size, -1 for no limit
+    std::atomic<int> hits;
+    std::atomic<int> misses;
 
-    machine.SetDebugMode(true);
+    CompileCache() : maxBytes(-1), hits(0), misses(0) {}
+};
 
-    printf("GameMonkey source code compiler v1.0\n\n");
+// Byte code sequences counted over every compiled lib, see countSequences().
+struct SequenceCounts
+{
+    std::mutex lock;
+    std::map<std::string, long long> counts;
+    long long instructions;
+    int functions;
+
+    SequenceCounts() : instructions(0), functions(0) {}
+};
+
+struct CompileOptions
+{
+    bool gamecube;
+    bool compress;
+    CompileCache* cache;
+    SequenceCounts* sequences;
+};
+
+static bool readFile(const char* path, std::string& data)
+{
+    FILE* file = fopen(path, "rb");
+    long size;
+    bool result;
 
-    if (argc < 3 || argc > 4)
+    if (!file)
     {
-        printUsage();
-        goto done;
+        return false;
     }
 
-    if (argc == 3)
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data.resize(size);
+    result = size > 0 && fread(&data[0], size, 1, file) == 1;
+    fclose(file);
+
+    return result;
+}
+
+static bool writeFile(const char* path, const void* data, unsigned int size, std::string& message)
+{
+    FILE* file = fopen(path, "wb");
+    bool result;
+
+    if (!file)
     {
-        inpath = argv[1];
-        outpath = argv[2];
+        message = "Error: could not open output file.";
+        return false;
     }
-    else
+
+    result = fwrite(data, size, 1, file) == 1;
+    fclose(file);
+
+    if (!result)
     {
-        if (strcmp(argv[1], "-g") != 0)
+        message = "Error: could not write output file.";
+    }
+
+    return result;
+}
+
+// A 64 bit FNV-1a hash and a CRC-32 of the key text, plus the source size, so two sources only
+// share an entry if both hashes and the size collide.
+static std::string cachePathFor(const CompileCache& cache, const CompileOptions& options,
+    const char* source, unsigned int size)
+{
+    std::string key = "gm " GM_VERSION " cache " COMPILE_CACHE_VERSION;
+    unsigned long long hash = 14695981039346656037ULL;
+    char name[64];
+
+    key += options.gamecube ? " big" : " little";
+    key += options.compress ? " z\n" : "\n";
+    key.append(source, size);
+
+    for (size_t i = 0; i < key.size(); i++)
+    {
+        hash = (hash ^ (unsigned char)key[i]) * 1099511628211ULL;
+    }
+
+    sprintf(name, "%016llx%08x%08x.gml", hash, (unsigned int)gmCrc32String(key.c_str()), size);
+    return cache.dirpath + "/" + name;
+}
+
+// Reads a cached lib, and marks it as recently used for trimCache().
+static bool loadCachedLib(const std::string& path, std::string& lib)
+{
+    gmuint32 magic;
+
+    if (!readFile(path.c_str(), lib) || lib.size() < sizeof(magic))
+    {
+        return false;
+    }
+
+    memcpy(&magic, lib.data(), sizeof(magic));
+
+    if (magic != 'gml0' && magic != '0lmg')
+    {
+        return false;
+    }
+
+#ifdef _WIN32
+    _utime(path.c_str(), NULL);
+#else
+    utime(path.c_str(), NULL);
+#endif
+
+    return true;
+}
+
+// Writes the entry under a name of its own first, so other workers and processes never read a
+// partly written entry. The name holds the process and thread, thread ids alone repeat across processes.
+static void storeCachedLib(const std::string& path, const void* lib, unsigned int size)
+{
+    std::string message;
+    char suffix[48];
+
+#ifdef _WIN32
+    unsigned int process = (unsigned int)GetCurrentProcessId();
+#else
+    unsigned int process = (unsigned int)getpid();
+#endif
+
+    sprintf(suffix, ".%08x.%08x.tmp", process, (unsigned int)std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::string temppath = path + suffix;
+
+    if (!writeFile(temppath.c_str(), lib, size, message) || rename(temppath.c_str(), path.c_str()) != 0)
+    {
+        remove(temppath.c_str());
+    }
+}
+
+struct CacheFile
+{
+    std::string path;
+    unsigned long long size;
+    unsigned long long time;
+
+    bool operator<(const CacheFile& other) const { return time < other.time; }
+};
+
+// Only names made by cachePathFor() count as entries, so other files in the directory and the
+// temp files of compiles still running are never removed.
+static bool isCacheEntryName(const char* name)
+{
+    for (int i = 0; i < 32; i++)
+    {
+        if (!((name[i] >= '0' && name[i] <= '9') || (name[i] >= 'a' && name[i] <= 'f')))
         {
-            printUsage();
-            goto done;
+            return false;
         }
+    }
 
-        stream.SetEndianOnWrite(GM_ENDIAN_BIG);
+    return strcmp(name + 32, ".gml") == 0;
+}
 
-        inpath = argv[2];
-        outpath = argv[3];
+// Removes the least recently used entries until the cache holds at most maxBytes.
+static void trimCache(const CompileCache& cache)
+{
+    std::vector<CacheFile> files;
+    unsigned long long totalBytes = 0;
+    int removed = 0;
+
+    if (cache.maxBytes < 0)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA findData;
+    HANDLE find = FindFirstFileA((cache.dirpath + "\\*").c_str(), &findData);
+
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && isCacheEntryName(findData.cFileName))
+            {
+                CacheFile file;
+                file.path = cache.dirpath + "\\" + findData.cFileName;
+                file.size = ((unsigned long long)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+                file.time = ((unsigned long long)findData.ftLastWriteTime.dwHighDateTime << 32) |
+                    findData.ftLastWriteTime.dwLowDateTime;
+                files.push_back(file);
+            }
+        } while (FindNextFileA(find, &findData));
+
+        FindClose(find);
+    }
+#else
+    DIR* dir = opendir(cache.dirpath.c_str());
+    struct dirent* entry;
+    struct stat info;
+
+    if (dir)
+    {
+        while ((entry = readdir(dir)) != NULL)
+        {
+            if (!isCacheEntryName(entry->d_name))
+            {
+                continue;
+            }
+
+            CacheFile file;
+            file.path = cache.dirpath + "/" + entry->d_name;
+
+            if (stat(file.path.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+            {
+                file.size = info.st_size;
+                file.time = info.st_mtime;
+                files.push_back(file);
+            }
+        }
+
+        closedir(dir);
+    }
+#endif
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        totalBytes += files[i].size;
+    }
+
+    std::sort(files.begin(), files.end());
+
+    for (size_t i = 0; i < files.size() && totalBytes > (unsigned long long)cache.maxBytes; i++)
+    {
+        if (remove(files[i].path.c_str()) == 0)
+        {
+            totalBytes -= files[i].size;
+            removed++;
+        }
+    }
+
+    if (removed)
+    {
+        printf("Cache: trimmed %d entries, %.2f MB left.\n", removed, (double)totalBytes / (1024.0 * 1024.0));
+    }
+}
+
+static void finishCache(const CompileCache& cache)
+{
+    int lookups = cache.hits + cache.misses;
+
+    printf("Cache: %d hits, %d misses (%.1f%% hit rate).\n", (int)cache.hits, (int)cache.misses,
+        lookups ? 100.0 * cache.hits / lookups : 0.0);
+
+    trimCache(cache);
+}
+
+static bool isControlTransfer(gmuint32 byteCode)
+{
+    switch (byteCode)
+    {
+    case BC_BRA:
+    case BC_BRZ:
+    case BC_BRNZ:
+    case BC_BRZK:
+    case BC_BRNZK:
+    case BC_CALL:
+    case BC_RET:
+    case BC_RETV:
+    case BC_FOREACH:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Counts the sequences of 2 to 4 byte codes in every function of a lib. A sequence may end in a
+// branch, call or return but does not run on past one, and line markers are left out as they
+// split the code of one line from the next.
+static void countSequences(SequenceCounts& sequences, const void* lib, unsigned int size)
+{
+    gmStreamBufferStatic stream(lib, size);
+    std::map<std::string, long long> counts;
+    std::vector<gmuint32> byteCode;
+    std::vector<gmuint32> ops;
+    gmuint32 header[5]; // id, flags, string table offset, source code offset, functions offset
+    gmuint32 numFunctions;
+    gmuint32 function[7]; // 'func', id, flags, num params, num locals, max stack size, byte code length
+    long long instructions = 0;
+    int functions = 0;
+
+    if (size >= sizeof(gmuint32) && *(const gmuint32*)lib == '0lmg')
+    {
+        stream.SetSwapEndianOnWrite(true);
+    }
+
+    if (stream.Read(header, sizeof(header), true) != sizeof(header) || header[0] != 'gml0')
+    {
+        return;
+    }
+
+    stream.Seek(header[4]);
+
+    if (stream.Read(&numFunctions, sizeof(numFunctions), true) != sizeof(numFunctions))
+    {
+        return;
+    }
+
+    for (gmuint32 f = 0; f < numFunctions; f++)
+    {
+        if (stream.Read(function, sizeof(function), true) != sizeof(function) || function[0] != 'func')
+        {
+            break;
+        }
+
+        byteCode.resize(function[6] / sizeof(gmuint32));
+
+        if (!byteCode.empty() && stream.Read(&byteCode[0], function[6], true) != function[6])
+        {
+            break;
+        }
+
+        ops.clear();
+
+        for (size_t i = 0; i < byteCode.size(); i += 1 + gmByteCodeOperandSize(byteCode[i]) / sizeof(gmuint32))
+        {
+            ops.push_back(byteCode[i]);
+        }
+
+        for (size_t i = 0; i < ops.size(); i++)
+        {
+            std::string sequence = gmGetByteCodeName(ops[i]);
+
+            for (size_t j = i + 1; j < ops.size() && j < i + 4; j++)
+            {
+                if (ops[j - 1] == BC_LINE || ops[j] == BC_LINE || isControlTransfer(ops[j - 1]))
+                {
+                    break;
+                }
+
+                sequence += ", ";
+                sequence += gmGetByteCodeName(ops[j]);
+                counts[sequence]++;
+            }
+        }
+
+        instructions += ops.size();
+        functions++;
+
+        // skip the debug info, the debug name offset, line info and symbol offsets
+        if (header[1] & 1)
+        {
+            gmuint32 debug[2];
+
+            if (stream.Read(debug, sizeof(debug), true) != sizeof(debug))
+            {
+                break;
+            }
+
+            stream.Seek(stream.Tell() + debug[1] * 2 * sizeof(gmuint32) + (function[3] + function[4]) * sizeof(gmuint32));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(sequences.lock);
+
+    for (std::map<std::string, long long>::const_iterator i = counts.begin(); i != counts.end(); ++i)
+    {
+        sequences.counts[i->first] += i->second;
+    }
+
+    sequences.instructions += instructions;
+    sequences.functions += functions;
+}
+
+// Prints the sequences that would save the most dispatches as superinstructions, each
+// saving one per byte code after the first.
+static void printSequences(const SequenceCounts& sequences, int count)
+{
+    std::vector<std::pair<long long, std::string> > sorted;
+
+    for (std::map<std::string, long long>::const_iterator i = sequences.counts.begin(); i != sequences.counts.end(); ++i)
+    {
+        long long length = std::count(i->first.begin(), i->first.end(), ',') + 1;
+        sorted.push_back(std::make_pair(i->second * (length - 1), i->first));
+    }
+
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<long long, std::string>& a,
+        const std::pair<long long, std::string>& b)
+    {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    printf("Byte code sequences in %d functions of %lld byte codes:\n", sequences.functions, sequences.instructions);
+    printf("%10s %10s  %s\n", "count", "saved", "sequence");
+
+    for (int i = 0; i < count && i < (int)sorted.size(); i++)
+    {
+        long long length = std::count(sorted[i].second.begin(), sorted[i].second.end(), ',') + 1;
+        printf("%10lld %10lld  %s\n", sorted[i].first / (length - 1), sorted[i].first, sorted[i].second.c_str());
+    }
+}
+
+// Compiles the source file at inpath and writes the lib to outpath, or into lib when it is not NULL.
+// When the cache holds a lib for the same source and options it is used and nothing is compiled.
+// On failure, message receives the same error text the single file mode prints.
+static bool compileFile(gmMachine& machine, const char* inpath, const char* outpath,
+    const CompileOptions& options, std::string* lib, std::string& message, unsigned int& insize)
+{
+    bool result = false;
+    FILE* infile = NULL;
+    char* source = NULL;
+    gmStreamBufferDynamic stream;
+    std::string cachepath;
+    std::string cached;
+    const void* outdata;
+    int outsize;
+    int errors;
+
+    insize = 0;
+
+    if (options.gamecube)
+    {
+        stream.SetEndianOnWrite(GM_ENDIAN_BIG);
     }
 
     infile = fopen(inpath, "rb");
 
     if (!infile)
     {
-        printf("Error: could not open input file.");
+        message = "Error: could not open input file.";
         goto done;
     }
 
@@ -70,47 +495,363 @@ int main(int argc, char** argv)
 
     if (fread(source, insize, 1, infile) != 1)
     {
-        printf("Error: could not read input file.");
+        message = "Error: could not read input file.";
         goto done;
     }
 
     fclose(infile);
     infile = NULL;
 
-    errors = machine.CompileStringToLib(source, stream);
+    if (options.cache)
+    {
+        cachepath = cachePathFor(*options.cache, options, source, insize);
+
+        if (loadCachedLib(cachepath, cached))
+        {
+            options.cache->hits++;
+            outdata = cached.data();
+            outsize = (int)cached.size();
+            goto write;
+        }
+
+        options.cache->misses++;
+    }
+
+    errors = machine.CompileStringToLib(source, stream, options.compress);
 
     if (errors)
     {
         bool first = true;
-        const char* message;
+        const char* entry;
 
-        printf("Error: could not compile gm lib.\n\n");
+        message = "Error: could not compile gm lib.\n\n";
 
-        while (message = machine.GetLog().GetEntry(first))
+        while ((entry = machine.GetLog().GetEntry(first)) != NULL)
         {
-            printf("%s\n", message);
+            message += entry;
+            message += "\n";
         }
 
         goto done;
     }
 
+    outdata = stream.GetData();
     outsize = stream.GetSize();
-    outfile = fopen(outpath, "wb");
 
-    if (!outfile)
+    if (options.cache)
+    {
+        storeCachedLib(cachepath, outdata, outsize);
+    }
+
+write:
+    if (options.sequences)
+    {
+        countSequences(*options.sequences, outdata, outsize);
+    }
+
+    if (lib)
+    {
+        lib->assign((const char*)outdata, outsize);
+        result = true;
+        goto done;
+    }
+
+    if (!writeFile(outpath, outdata, outsize, message))
+    {
+        goto done;
+    }
+
+    result = true;
+
+done:
+    if (infile) fclose(infile);
+    if (source) delete[] source;
+
+    return result;
+}
+
+// Packs the compiled libs into one bundle. Entries are named by their lib path, relative to
+// the batch directory when one was given, with '/' separators.
+static bool writeBundle(const char* bundlepath, const char* inpath, bool fromDirectory,
+    const std::vector<BatchJob>& jobs, const std::vector<std::string>& libs, bool gamecube)
+{
+    gmLibBundleWriter writer;
+    gmStreamBufferDynamic stream;
+    std::string root = std::string(inpath) + "/";
+    std::string message;
+
+    if (gamecube)
+    {
+        stream.SetEndianOnWrite(GM_ENDIAN_BIG);
+    }
+
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        std::string name = jobs[i].outpath;
+
+        for (size_t c = 0; c < name.size(); c++)
+        {
+            if (name[c] == '\\')
+            {
+                name[c] = '/';
+            }
+        }
+
+        if (fromDirectory && name.compare(0, root.size(), root) == 0)
+        {
+            name = name.substr(root.size());
+        }
+
+        if (!isSafeEntryName(name))
+        {
+            printf("Error: bundle entry %s must be a relative path without '..'.", name.c_str());
+            return false;
+        }
+
+        if (!writer.Add(name.c_str(), libs[i].data(), (unsigned int)libs[i].size()))
+        {
+            printf("Error: duplicate bundle entry %s.", name.c_str());
+            return false;
+        }
+    }
+
+    writer.Write(stream);
+
+    if (!writeFile(bundlepath, stream.GetData(), stream.GetSize(), message))
+    {
+        printf("%s", message.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static int runBatch(const char* inpath, int threadCount, const CompileOptions& options, const char* bundlepath,
+    int sequenceCount)
+{
+    std::vector<BatchJob> jobs;
+    std::vector<std::string> libs;
+    std::vector<gmMachine*> machines;
+    bool fromDirectory = isDirectory(inpath);
+
+    if (fromDirectory)
+    {
+        findFiles(inpath, ".gm", ".gml", jobs);
+    }
+    else if (!readListFile(inpath, ".gml", jobs))
+    {
+        printf("Error: could not open batch input.");
+        return 1;
+    }
+
+    if (jobs.empty())
+    {
+        printf("Error: no gm source files found.");
+        return 1;
+    }
+
+    if (bundlepath)
+    {
+        libs.resize(jobs.size());
+    }
+
+    // each worker thread compiles with a machine of its own, made on its first job
+    machines.resize(threadCount, NULL);
+
+    BatchResult result = runBatchJobs((int)jobs.size(), threadCount,
+        [&](int index, int thread, std::string& message, unsigned int& bytes)
+    {
+        const BatchJob& job = jobs[index];
+
+        if (!machines[thread])
+        {
+            machines[thread] = new gmMachine;
+            machines[thread]->SetDebugMode(true);
+        }
+
+        if (!compileFile(*machines[thread], job.inpath.c_str(), job.outpath.c_str(), options,
+            bundlepath ? &libs[index] : NULL, message, bytes))
+        {
+            message = job.inpath + ":\n" + message;
+            return false;
+        }
+
+        return true;
+    });
+
+    for (size_t i = 0; i < machines.size(); i++)
     {
-        printf("Error: could not open output file.");
+        delete machines[i];
+    }
+
+    int compiled = (int)jobs.size() - result.failed;
+
+    printf("Compiled %d of %d files on %d threads in %.3fs (%.1f files/s, %.2f MB/s).\n",
+        compiled, (int)jobs.size(), result.threadCount, result.seconds,
+        compiled / result.seconds, (double)result.totalBytes / (1024.0 * 1024.0) / result.seconds);
+
+    if (options.cache)
+    {
+        finishCache(*options.cache);
+    }
+
+    if (options.sequences)
+    {
+        printSequences(*options.sequences, sequenceCount);
+    }
+
+    if (result.failed)
+    {
+        printf("Error: %d files failed to compile.", result.failed);
+        return 1;
+    }
+
+    if (bundlepath && !writeBundle(bundlepath, inpath, fromDirectory, jobs, libs, options.gamecube))
+    {
+        return 1;
+    }
+
+    printf("Done.");
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int rc = 1;
+    CompileOptions options = { false, false, NULL, NULL };
+    CompileCache cache;
+    SequenceCounts sequences;
+    int sequenceCount = 0;
+    bool batch = false;
+    int threadCount = 0;
+    const char* bundlepath = NULL;
+    char* paths[2];
+    int numPaths = 0;
+
+    printf("GameMonkey source code compiler v1.0\n\n");
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "-g") == 0)
+        {
+            options.gamecube = true;
+        }
+        else if (strcmp(argv[arg], "-z") == 0)
+        {
+            options.compress = true;
+        }
+        else if (strcmp(argv[arg], "--batch") == 0)
+        {
+            batch = true;
+        }
+        else if (strcmp(argv[arg], "--bundle") == 0 && arg + 1 < argc)
+        {
+            bundlepath = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--cache") == 0 && arg + 1 < argc)
+        {
+            cache.dirpath = argv[++arg];
+            options.cache = &cache;
+        }
+        else if (strcmp(argv[arg], "--cache-size") == 0 && arg + 1 < argc)
+        {
+            cache.maxBytes = atoll(argv[++arg]) * 1024 * 1024;
+
+            if (cache.maxBytes < 0)
+            {
+                printUsage();
+                goto done;
+            }
+        }
+        else if (strcmp(argv[arg], "--sequences") == 0 && arg + 1 < argc)
+        {
+            sequenceCount = atoi(argv[++arg]);
+            options.sequences = &sequences;
+
+            if (sequenceCount <= 0)
+            {
+                printUsage();
+                goto done;
+            }
+        }
+        else if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc)
+        {
+            threadCount = atoi(argv[++arg]);
+
+            if (threadCount <= 0)
+            {
+                printUsage();
+                goto done;
+            }
+        }
+        else if (argv[arg][0] != '-' && numPaths < 2)
+        {
+            paths[numPaths++] = argv[arg];
+        }
+        else
+        {
+            printUsage();
+            goto done;
+        }
+    }
+
+    if (options.cache && !makeDirectories(cache.dirpath))
+    {
+        printf("Error: could not create cache directory.");
+        goto done;
+    }
+
+    if (batch)
+    {
+        if (numPaths != 1)
+        {
+            printUsage();
+            goto done;
+        }
+
+        if (threadCount == 0)
+        {
+            threadCount = (int)std::thread::hardware_concurrency();
+
+            if (threadCount <= 0)
+            {
+                threadCount = 1;
+            }
+        }
+
+        rc = runBatch(paths[0], threadCount, options, bundlepath, sequenceCount);
         goto done;
     }
 
-    if (fwrite(stream.GetData(), outsize, 1, outfile) != 1)
+    if (threadCount != 0 || bundlepath || numPaths != 2)
     {
-        printf("Error: could not write output file.");
+        printUsage();
         goto done;
     }
 
-    fclose(outfile);
-    outfile = NULL;
+    {
+        gmMachine machine;
+        std::string message;
+        unsigned int insize;
+
+        machine.SetDebugMode(true);
+
+        if (!compileFile(machine, paths[0], paths[1], options, NULL, message, insize))
+        {
+            printf("%s", message.c_str());
+            goto done;
+        }
+
+        if (options.cache)
+        {
+            finishCache(cache);
+        }
+
+        if (options.sequences)
+        {
+            printSequences(sequences, sequenceCount);
+        }
+    }
 
     printf("Done.");
 
@@ -119,8 +860,5 @@ int main(int argc, char** argv)
 done:
     printf("\n");
 
-    if (infile) fclose(infile);
-    if (outfile) fclose(outfile);
-
     return rc;
-}
\ No newline at end of file
+}
@@ -1,61 +1,96 @@
-#include "gmMachine.h"
+#include "gmLibBundle.h"
 #include "gmLibHooks.h"
-#include "gmStreamBuffer.h"
+#include "gmStreamMapped.h"
+#include "batch.h"
 
 #include <stdio.h>
+#include <string.h>
 
-int main(int argc, char** argv)
+#include <string>
+#include <thread>
+#include <vector>
+
+static void printUsage()
 {
-    int rc = 1;
-    FILE* infile = NULL;
-    FILE* outfile = NULL;
-    int insize;
-    char* buffer = NULL;
-    gmuint32 magic;
-    gmMachine machine;
-    gmStreamBufferStatic stream;
-    gmFunctionObject* func = NULL;
-    const char* source;
-    const char* fname;
-    int outsize;
+    printf("Usage:\n"
+        "  extract <input gm lib file> <output gm source file>\n"
+        "  extract --batch <input directory or list file> [-j <thread count>]\n"
+        "  extract --bundle <input gm lib bundle file> <output directory> [-j <thread count>]");
+}
 
-    machine.SetDebugMode(true);
+// Writes the source code of the lib in stream to outpath. Only the lib header and
+// source code section are read, no functions are bound.
+static bool extractStream(gmStream& stream, const char* outpath, std::string& message, unsigned int& outsize)
+{
+    bool result = false;
+    FILE* outfile = NULL;
+    const char* source = NULL;
+    char* sourceCopy = NULL;
 
-    printf("GameMonkey source code extractor v1.0\n\n");
+    outsize = 0;
 
-    if (argc != 3)
+    // uncompressed source is written straight from the mapping
+    if (!gmLibHooks::ReadSource(stream, source, sourceCopy))
     {
-        printf("Usage:\n"
-               "  extract <input gm lib file> <output gm source file>");
+        message = "Error: could not parse input file.";
         goto done;
     }
 
-    infile = fopen(argv[1], "rb");
-
-    if (!infile)
+    if (!source)
     {
-        printf("Error: could not open input file.");
+        message = "Error: no source code was found in input file.";
         goto done;
     }
 
-    fseek(infile, 0, SEEK_END);
-    insize = ftell(infile);
-    fseek(infile, 0, SEEK_SET);
+    outsize = strlen(source);
+    outfile = fopen(outpath, "wb");
 
-    buffer = new char[insize];
+    if (!outfile)
+    {
+        message = "Error: could not open output file.";
+        goto done;
+    }
 
-    if (fread(buffer, insize, 1, infile) != 1)
+    if (outsize && fwrite(source, outsize, 1, outfile) != 1)
     {
-        printf("Error: could not read input file.");
+        message = "Error: could not write output file.";
         goto done;
     }
 
-    fclose(infile);
-    infile = NULL;
+    fclose(outfile);
+    outfile = NULL;
+
+    result = true;
+
+done:
+    if (outfile) fclose(outfile);
+    if (sourceCopy) delete[] sourceCopy;
+
+    return result;
+}
 
-    stream.Open(buffer, insize);
+// Writes the source code of the lib at inpath to outpath.
+// On failure, message receives the same error text the single file mode prints.
+static bool extractFile(const char* inpath, const char* outpath, std::string& message, unsigned int& outsize)
+{
+    gmuint32 magic;
+    gmStreamMapped stream;
+
+    outsize = 0;
+
+    if (!stream.Open(inpath))
+    {
+        message = "Error: could not open input file.";
+        return false;
+    }
+
+    if (stream.GetSize() < sizeof(magic))
+    {
+        message = "Error: input file is not a valid gm lib.";
+        return false;
+    }
 
-    magic = *(gmuint32*)buffer;
+    magic = *(const gmuint32*)stream.GetData();
 
     if (magic != 'gml0')
     {
@@ -65,42 +100,216 @@ int main(int argc, char** argv)
         }
         else
         {
-            printf("Error: input file is not a valid gm lib.");
-            goto done;
+            message = "Error: input file is not a valid gm lib.";
+            return false;
         }
     }
-    
-    func = gmLibHooks::BindLib(machine, stream, NULL);
 
-    if (!func)
+    return extractStream(stream, outpath, message, outsize);
+}
+
+static int runBatch(const char* inpath, int threadCount)
+{
+    std::vector<BatchJob> jobs;
+
+    if (isDirectory(inpath))
     {
-        printf("Error: could not parse input file.");
-        goto done;
+        findFiles(inpath, ".gml", ".gm", jobs);
+    }
+    else if (!readListFile(inpath, ".gm", jobs))
+    {
+        printf("Error: could not open batch input.");
+        return 1;
     }
 
-    if (!machine.GetSourceCode(func->GetSourceId(), source, fname))
+    if (jobs.empty())
     {
-        printf("Error: no source code was found in input file.");
-        goto done;
+        printf("Error: no gm lib files found.");
+        return 1;
     }
 
-    outsize = strlen(source);
-    outfile = fopen(argv[2], "wb");
+    BatchResult result = runBatchJobs((int)jobs.size(), threadCount,
+        [&](int index, int, std::string& message, unsigned int& bytes)
+    {
+        const BatchJob& job = jobs[index];
 
-    if (!outfile)
+        if (!extractFile(job.inpath.c_str(), job.outpath.c_str(), message, bytes))
+        {
+            message = job.inpath + ":\n" + message;
+            return false;
+        }
+
+        return true;
+    });
+
+    int extracted = (int)jobs.size() - result.failed;
+
+    printf("Extracted %d of %d files on %d threads in %.3fs (%.1f files/s, %.2f MB/s).\n",
+        extracted, (int)jobs.size(), result.threadCount, result.seconds,
+        extracted / result.seconds, (double)result.totalBytes / (1024.0 * 1024.0) / result.seconds);
+
+    if (result.failed)
+    {
+        printf("Error: %d files failed to extract.", result.failed);
+        return 1;
+    }
+
+    printf("Done.");
+    return 0;
+}
+
+// Writes the source code of every lib in the bundle below outdir, named by its bundle entry.
+// The bundle is mapped, so its entries are read in place and can be extracted in parallel.
+static int runBundle(const char* inpath, const char* outdir, int threadCount)
+{
+    gmStreamMapped stream;
+    gmLibBundle bundle;
+
+    if (!stream.Open(inpath))
     {
-        printf("Error: could not open output file.");
+        printf("Error: could not open input file.");
+        return 1;
+    }
+
+    if (!bundle.Open(stream))
+    {
+        printf("Error: input file is not a valid gm lib bundle.");
+        return 1;
+    }
+
+    int numEntries = bundle.GetNumEntries();
+
+    if (numEntries == 0)
+    {
+        printf("Error: no gm libs found in bundle.");
+        return 1;
+    }
+
+    BatchResult result = runBatchJobs(numEntries, threadCount,
+        [&](int index, int, std::string& message, unsigned int& bytes)
+    {
+        std::string outpath = std::string(outdir) + "/" + replaceExtension(bundle.GetName(index), ".gm");
+        gmStreamRange entry;
+
+        if (!isSafeEntryName(bundle.GetName(index)))
+        {
+            // never write outside outdir, whatever made the bundle
+            message = "Error: entry name is not a relative path below the output directory.";
+        }
+        else
+        {
+            makeParentDirectories(outpath);
+
+            if (!bundle.OpenEntry(index, entry))
+            {
+                message = "Error: could not parse input file.";
+            }
+            else if (extractStream(entry, outpath.c_str(), message, bytes))
+            {
+                return true;
+            }
+        }
+
+        message = std::string(bundle.GetName(index)) + ":\n" + message;
+        return false;
+    });
+
+    int extracted = numEntries - result.failed;
+
+    printf("Extracted %d of %d libs on %d threads in %.3fs (%.1f libs/s, %.2f MB/s).\n",
+        extracted, numEntries, result.threadCount, result.seconds,
+        extracted / result.seconds, (double)result.totalBytes / (1024.0 * 1024.0) / result.seconds);
+
+    if (result.failed)
+    {
+        printf("Error: %d libs failed to extract.", result.failed);
+        return 1;
+    }
+
+    printf("Done.");
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int rc = 1;
+    bool batch = false;
+    bool unbundle = false;
+    int threadCount = 0;
+    char* paths[2];
+    int numPaths = 0;
+
+    printf("GameMonkey source code extractor v1.0\n\n");
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--batch") == 0)
+        {
+            batch = true;
+        }
+        else if (strcmp(argv[arg], "--bundle") == 0)
+        {
+            unbundle = true;
+        }
+        else if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc)
+        {
+            threadCount = atoi(argv[++arg]);
+
+            if (threadCount <= 0)
+            {
+                printUsage();
+                goto done;
+            }
+        }
+        else if (argv[arg][0] != '-' && numPaths < 2)
+        {
+            paths[numPaths++] = argv[arg];
+        }
+        else
+        {
+            printUsage();
+            goto done;
+        }
+    }
+
+    if (batch || unbundle)
+    {
+        if (batch == unbundle || numPaths != (batch ? 1 : 2))
+        {
+            printUsage();
+            goto done;
+        }
+
+        if (threadCount == 0)
+        {
+            threadCount = (int)std::thread::hardware_concurrency();
+
+            if (threadCount <= 0)
+            {
+                threadCount = 1;
+            }
+        }
+
+        rc = batch ? runBatch(paths[0], threadCount) : runBundle(paths[0], paths[1], threadCount);
         goto done;
     }
 
-    if (fwrite(source, outsize, 1, outfile) != 1)
+    if (threadCount != 0 || numPaths != 2)
     {
-        printf("Error: could not write output file.");
+        printUsage();
         goto done;
     }
 
-    fclose(outfile);
-    outfile = NULL;
+    {
+        std::string message;
+        unsigned int outsize;
+
+        if (!extractFile(paths[0], paths[1], message, outsize))
+        {
+            printf("%s", message.c_str());
+            goto done;
+        }
+    }
 
     printf("Done.");
 
@@ -109,8 +318,5 @@ int main(int argc, char** argv)
 done:
     printf("\n");
 
-    if (infile) fclose(infile);
-    if (outfile) fclose(outfile);
-
     return rc;
-}
\ No newline at end of file
+}
@@ -0,0 +1,522 @@
+/*
+    _____               __  ___          __            ____        _      __
+   / ___/__ ___ _  ___ /  |/  /__  ___  / /_____ __ __/ __/_______(_)__  / /_
+  / (_ / _ `/  ' \/ -_) /|_/ / _ \/ _ \/  '_/ -_) // /\ \/ __/ __/ / _ \/ __/
+  \___/\_,_/_/_/_/\__/_/  /_/\___/_//_/_/\_\\__/\_, /___/\__/_/ /_/ .__/\__/
+                                               /___/             /_/
+
+  See Copyright Notice in gmMachine.h
+
+*/
+
+#include "gmConfig.h"
+#include "gmMachinePool.h"
+#include "gmMachine.h"
+#include "gmThread.h"
+
+#include <atomic>
+#include <thread>
+
+/// \struct gmMachinePoolMessage
+/// \brief gmMachinePoolMessage is a posted value and signal, serialized as a type byte followed by an int, a float,
+///        a length and 0 terminated characters, or a count and key value pairs.
+struct gmMachinePoolMessage
+{
+    gmMachinePoolMessage* m_next;
+    unsigned int m_valueSize; //!< 0 for a signal only message
+    unsigned int m_signalSize; //!< 0 for no signal, follows the value
+};
+
+/// \struct gmMachinePoolWorker
+/// \brief gmMachinePoolWorker is a pool machine and the OS thread that runs it.
+struct gmMachinePoolWorker
+{
+    gmMachinePool* m_pool;
+    int m_index;
+    gmMachine* m_machine;
+    std::thread m_thread;
+    std::atomic<gmMachinePoolMessage*> m_inbox; //!< posted messages, newest first
+    gmMachinePoolMessage* m_mailFirst; //!< delivered values, oldest first
+    gmMachinePoolMessage* m_mailLast;
+    int m_numThreads;
+};
+
+static GM_THREAD_LOCAL gmMachinePoolWorker* s_worker = NULL; // worker that runs on this OS thread
+
+//
+// Serialization
+//
+
+// write a value to a_dest, or just measure it when a_dest is NULL.  tables may only hold ints, floats and strings.
+// returns the size, or -1 for a value that can not be posted.
+static int gmMachinePoolWrite(gmMachine* a_machine, const gmVariable& a_var, char* a_dest, bool a_scalar)
+{
+    int size = 1;
+    switch(a_var.m_type)
+    {
+        case GM_INT:
+        case GM_FLOAT:
+        {
+            size += sizeof(gmint32);
+            if(a_dest) memcpy(a_dest + 1, &a_var.m_value, sizeof(gmint32));
+            break;
+        }
+        case GM_STRING:
+        {
+            const gmStringObject* string = (const gmStringObject*) GM_MOBJECT(a_machine, a_var.m_value.m_ref);
+            gmuint32 length = (gmuint32) string->GetLength();
+            size += sizeof(gmuint32) + length + 1;
+            if(a_dest)
+            {
+                // with its terminator, as gmMachine::AllocStringObject() finds strings by their contents
+                memcpy(a_dest + 1, &length, sizeof(gmuint32));
+                memcpy(a_dest + 1 + sizeof(gmuint32), string->GetString(), length + 1);
+            }
+            break;
+        }
+        case GM_TABLE:
+        {
+            if(a_scalar) return -1;
+            gmTableObject* table = (gmTableObject*) GM_MOBJECT(a_machine, a_var.m_value.m_ref);
+            gmuint32 count = (gmuint32) table->Count();
+            size += sizeof(gmuint32);
+            if(a_dest) memcpy(a_dest + 1, &count, sizeof(gmuint32));
+
+            gmTableIterator it;
+            gmTableNode* node = table->GetFirst(it);
+            while(node)
+            {
+                int keySize = gmMachinePoolWrite(a_machine, node->m_key, (a_dest) ? a_dest + size : NULL, true);
+                if(keySize < 0) return -1;
+                size += keySize;
+                int valueSize = gmMachinePoolWrite(a_machine, node->m_value, (a_dest) ? a_dest + size : NULL, true);
+                if(valueSize < 0) return -1;
+                size += valueSize;
+                node = table->GetNext(it);
+            }
+            break;
+        }
+        default:
+        {
+            return -1;
+        }
+    }
+    if(a_dest) *a_dest = (char) a_var.m_type;
+    return size;
+}
+
+
+// read an int, float or string written by gmMachinePoolWrite(), and return the data following it
+static const char* gmMachinePoolRead(gmMachine* a_machine, const char* a_src, gmVariable& a_var)
+{
+    gmType type = (gmType) *(a_src++);
+    if(type == GM_STRING)
+    {
+        gmuint32 length;
+        memcpy(&length, a_src, sizeof(gmuint32));
+        a_src += sizeof(gmuint32);
+        a_var.SetString(a_machine->AllocStringObject(a_src, (int) length));
+        return a_src + length + 1;
+    }
+    a_var.m_type = type;
+    memcpy(&a_var.m_value, a_src, sizeof(gmint32));
+    return a_src + sizeof(gmint32);
+}
+
+//
+// gmMachinePool
+//
+
+gmMachinePool::gmMachinePool()
+{
+    m_workers = NULL;
+    m_numWorkers = 0;
+    m_init = NULL;
+    m_user = NULL;
+    m_frame = 0;
+    m_delta = 0;
+    m_numBusy = 0;
+    m_failed = false;
+    m_quit = false;
+}
+
+
+gmMachinePool::~gmMachinePool()
+{
+    Close();
+}
+
+
+bool gmMachinePool::Open(int a_numMachines, gmMachinePoolInitCallback a_init, void* a_user)
+{
+    Close();
+    if(a_numMachines <= 0) return false;
+
+    m_init = a_init;
+    m_user = a_user;
+    m_failed = false;
+    m_quit = false;
+    m_numBusy = a_numMachines;
+    m_numWorkers = a_numMachines;
+    m_workers = new gmMachinePoolWorker[a_numMachines];
+    for(int i = 0; i < a_numMachines; ++i)
+    {
+        gmMachinePoolWorker& worker = m_workers[i];
+        worker.m_pool = this;
+        worker.m_index = i;
+        worker.m_machine = NULL;
+        worker.m_inbox = NULL;
+        worker.m_mailFirst = NULL;
+        worker.m_mailLast = NULL;
+        worker.m_numThreads = 0;
+    }
+
+    // machines may post to each other as they are initialised, so start them once every inbox is ready
+    for(int i = 0; i < a_numMachines; ++i)
+    {
+        m_workers[i].m_thread = std::thread(Run, &m_workers[i]);
+    }
+
+    // wait for the machines to be created and initialised
+    bool failed;
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_done.wait(lock, [this]() { return m_numBusy == 0; });
+        failed = m_failed;
+    }
+    if(failed)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+
+void gmMachinePool::Close()
+{
+    if(!m_workers) return;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_quit = true;
+    }
+    m_start.notify_all();
+    for(int i = 0; i < m_numWorkers; ++i)
+    {
+        m_workers[i].m_thread.join();
+    }
+    delete[] m_workers;
+    m_workers = NULL;
+    m_numWorkers = 0;
+}
+
+
+gmMachine* gmMachinePool::GetMachine(int a_index) const
+{
+    if(a_index < 0 || a_index >= m_numWorkers) return NULL;
+    return m_workers[a_index].m_machine;
+}
+
+
+int gmMachinePool::Execute(gmuint32 a_delta)
+{
+    if(!m_workers) return 0;
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_delta = a_delta;
+        m_numBusy = m_numWorkers;
+        ++m_frame;
+        m_start.notify_all();
+        m_done.wait(lock, [this]() { return m_numBusy == 0; });
+    }
+
+    int numThreads = 0;
+    for(int i = 0; i < m_numWorkers; ++i)
+    {
+        numThreads += m_workers[i].m_numThreads;
+    }
+    return numThreads;
+}
+
+
+bool gmMachinePool::Post(int a_to, gmMachine* a_from, const gmVariable& a_value, const gmVariable* a_signal)
+{
+    if(a_to < 0 || a_to >= m_numWorkers) return false;
+
+    int valueSize = 0, signalSize = 0;
+    if(a_value.m_type != GM_NULL)
+    {
+        valueSize = gmMachinePoolWrite(a_from, a_value, NULL, false);
+        if(valueSize < 0) return false;
+    }
+    if(a_signal)
+    {
+        signalSize = gmMachinePoolWrite(a_from, *a_signal, NULL, true);
+        if(signalSize < 0) return false;
+    }
+    if(valueSize == 0 && signalSize == 0) return false;
+
+    gmMachinePoolMessage* message = (gmMachinePoolMessage*) malloc(sizeof(gmMachinePoolMessage) + valueSize + signalSize);
+    char* data = (char*) (message + 1);
+    message->m_valueSize = valueSize;
+    message->m_signalSize = signalSize;
+    if(valueSize) gmMachinePoolWrite(a_from, a_value, data, false);
+    if(signalSize) gmMachinePoolWrite(a_from, *a_signal, data + valueSize, true);
+
+    // push onto the inbox, the receiver takes the whole list at once so there is no ABA
+    std::atomic<gmMachinePoolMessage*>& inbox = m_workers[a_to].m_inbox;
+    gmMachinePoolMessage* head = inbox.load(std::memory_order_relaxed);
+    do
+    {
+        message->m_next = head;
+    }
+    while(!inbox.compare_exchange_weak(head, message, std::memory_order_release, std::memory_order_relaxed));
+    return true;
+}
+
+
+gmMachinePool* gmMachinePool::GetCurrent(int* a_index)
+{
+    if(!s_worker) return NULL;
+    if(a_index) *a_index = s_worker->m_index;
+    return s_worker->m_pool;
+}
+
+
+bool gmMachinePool::Receive(gmThread* a_thread)
+{
+    gmMachinePoolWorker* worker = s_worker;
+    if(!worker || worker->m_machine != a_thread->GetMachine() || !worker->m_mailFirst) return false;
+
+    gmMachinePoolMessage* message = worker->m_mailFirst;
+    worker->m_mailFirst = message->m_next;
+    if(!worker->m_mailFirst) worker->m_mailLast = NULL;
+
+    gmMachine* machine = worker->m_machine;
+    const char* data = (const char*) (message + 1);
+    if(*data == GM_TABLE)
+    {
+        // the table is on the stack while its keys and values are allocated
+        gmTableObject* table = a_thread->PushNewTable();
+        gmuint32 count;
+        memcpy(&count, data + 1, sizeof(gmuint32));
+        data += 1 + sizeof(gmuint32);
+        while(count--)
+        {
+            gmVariable key, value;
+            data = gmMachinePoolRead(machine, data, key);
+            data = gmMachinePoolRead(machine, data, value);
+            table->Set(machine, key, value);
+        }
+    }
+    else
+    {
+        gmVariable value;
+        gmMachinePoolRead(machine, data, value);
+        a_thread->Push(value);
+    }
+    free(message);
+    return true;
+}
+
+
+void gmMachinePool::Run(gmMachinePoolWorker* a_worker)
+{
+    gmMachinePool* pool = a_worker->m_pool;
+    s_worker = a_worker;
+
+    // machines are created, run and destroyed on their own OS thread
+    a_worker->m_machine = new gmMachine;
+    bool ok = !pool->m_init || pool->m_init(a_worker->m_machine, a_worker->m_index, pool->m_user);
+
+    // start from the pool's current frame, a reopened pool has run frames before
+    gmuint32 frame;
+    {
+        std::lock_guard<std::mutex> lock(pool->m_lock);
+        frame = pool->m_frame;
+    }
+    pool->Done(a_worker, ok);
+
+    for(;;)
+    {
+        gmuint32 delta;
+        {
+            std::unique_lock<std::mutex> lock(pool->m_lock);
+            pool->m_start.wait(lock, [&]() { return pool->m_quit || pool->m_frame != frame; });
+            if(pool->m_quit) break;
+            frame = pool->m_frame;
+            delta = pool->m_delta;
+        }
+
+        // take the inbox, and deliver it in the order it was posted
+        gmMachinePoolMessage* message = a_worker->m_inbox.exchange(NULL, std::memory_order_acquire);
+        gmMachinePoolMessage* first = NULL;
+        while(message)
+        {
+            gmMachinePoolMessage* next = message->m_next;
+            message->m_next = first;
+            first = message;
+            message = next;
+        }
+        while(first)
+        {
+            message = first;
+            first = first->m_next;
+
+            gmVariable signal(GM_NULL, 0);
+            if(message->m_signalSize)
+            {
+                gmMachinePoolRead(a_worker->m_machine, (const char*) (message + 1) + message->m_valueSize, signal);
+            }
+            if(message->m_valueSize)
+            {
+                message->m_next = NULL;
+                if(a_worker->m_mailLast) a_worker->m_mailLast->m_next = message;
+                else a_worker->m_mailFirst = message;
+                a_worker->m_mailLast = message;
+            }
+            else
+            {
+                free(message);
+            }
+            if(signal.m_type != GM_NULL)
+            {
+                a_worker->m_machine->Signal(signal, GM_INVALID_THREAD, GM_INVALID_THREAD);
+            }
+        }
+
+        a_worker->m_numThreads = a_worker->m_machine->Execute(delta);
+        pool->Done(a_worker, true);
+    }
+
+    // free undelivered messages
+    gmMachinePoolMessage* message = a_worker->m_inbox.exchange(NULL, std::memory_order_acquire);
+    while(message)
+    {
+        gmMachinePoolMessage* next = message->m_next;
+        free(message);
+        message = next;
+    }
+    while(a_worker->m_mailFirst)
+    {
+        message = a_worker->m_mailFirst;
+        a_worker->m_mailFirst = message->m_next;
+        free(message);
+    }
+    a_worker->m_mailLast = NULL;
+
+    delete a_worker->m_machine;
+    a_worker->m_machine = NULL;
+    s_worker = NULL;
+}
+
+
+void gmMachinePool::Done(gmMachinePoolWorker* a_worker, bool a_ok)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    if(!a_ok) m_failed = true;
+    if(--m_numBusy == 0) m_done.notify_all();
+}
+
+//
+// Script functions
+//
+
+static int GM_CDECL gmMachineIndex(gmThread* a_thread)
+{
+    int index;
+    if(gmMachinePool::GetCurrent(&index)) a_thread->PushInt(index);
+    return GM_OK;
+}
+
+
+static int GM_CDECL gmMachineCount(gmThread* a_thread)
+{
+    gmMachinePool* pool = gmMachinePool::GetCurrent();
+    a_thread->PushInt((pool) ? pool->GetNumMachines() : 0);
+    return GM_OK;
+}
+
+
+static int GM_CDECL gmMachineSend(gmThread* a_thread) // machine, value, signal
+{
+    GM_CHECK_NUM_PARAMS(2);
+    GM_CHECK_INT_PARAM(index, 0);
+    gmMachinePool* pool = gmMachinePool::GetCurrent();
+    gmVariable value = a_thread->Param(1);
+    gmVariable signal = (a_thread->GetNumParams() > 2) ? a_thread->Param(2) : gmVariable(GM_NULL, 0);
+    bool sent = pool && value.m_type != GM_NULL &&
+                pool->Post(index, a_thread->GetMachine(), value, (signal.m_type != GM_NULL) ? &signal : NULL);
+    a_thread->PushInt(sent ? 1 : 0);
+    return GM_OK;
+}
+
+
+static int GM_CDECL gmMachineSignal(gmThread* a_thread) // machine, signal
+{
+    GM_CHECK_NUM_PARAMS(2);
+    GM_CHECK_INT_PARAM(index, 0);
+    gmMachinePool* pool = gmMachinePool::GetCurrent();
+    gmVariable signal = a_thread->Param(1);
+    bool sent = pool && pool->Post(index, a_thread->GetMachine(), gmVariable(GM_NULL, 0), &signal);
+    a_thread->PushInt(sent ? 1 : 0);
+    return GM_OK;
+}
+
+
+static int GM_CDECL gmMachineReceive(gmThread* a_thread)
+{
+    gmMachinePool::Receive(a_thread);
+    return GM_OK;
+}
+
+
+static gmFunctionEntry s_machinePoolLib[] =
+{
+    /*gm
+      \lib machinePool
+    */
+    /*gm
+      \function machineIndex
+      \brief machineIndex will return the index of this machine in its machine pool
+      \return int index, or null outside a pool
+    */
+    {"machineIndex", gmMachineIndex},
+    /*gm
+      \function machineCount
+      \brief machineCount will return the number of machines in this machine's pool
+      \return int count, 0 outside a pool
+    */
+    {"machineCount", gmMachineCount},
+    /*gm
+      \function machineSend
+      \brief machineSend will copy a value to the mailbox of another machine in the pool, where machineReceive takes
+             it.  The value arrives as that machine starts its next execute.
+      \param int machine index
+      \param value an int, float, string, or table of ints, floats and strings
+      \param signal optional int, float or string signalled on the machine once the value is in its mailbox
+      \return 1 if the value was sent, 0 otherwise
+    */
+    {"machineSend", gmMachineSend},
+    /*gm
+      \function machineSignal
+      \brief machineSignal will signal threads on another machine in the pool as it starts its next execute, see block.
+             As with signal, only threads blocked by then are woken, so check machineReceive before blocking.
+      \param int machine index
+      \param signal an int, float or string
+      \return 1 if the signal was sent, 0 otherwise
+    */
+    {"machineSignal", gmMachineSignal},
+    /*gm
+      \function machineReceive
+      \brief machineReceive will take the oldest value from this machine's mailbox
+      \return the value, or null if the mailbox is empty
+    */
+    {"machineReceive", gmMachineReceive},
+};
+
+
+void gmBindMachinePoolLib(gmMachine* a_machine)
+{
+    a_machine->RegisterLibrary(s_machinePoolLib, sizeof(s_machinePoolLib) / sizeof(s_machinePoolLib[0]));
+}
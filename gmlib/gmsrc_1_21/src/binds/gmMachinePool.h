@@ -0,0 +1,100 @@
+/*
+    _____               __  ___          __            ____        _      __
+   / ___/__ ___ _  ___ /  |/  /__  ___  / /_____ __ __/ __/_______(_)__  / /_
+  / (_ / _ `/  ' \/ -_) /|_/ / _ \/ _ \/  '_/ -_) // /\ \/ __/ __/ / _ \/ __/
+  \___/\_,_/_/_/_/\__/_/  /_/\___/_//_/_/\_\\__/\_, /___/\__/_/ /_/ .__/\__/
+                                               /___/             /_/
+
+  See Copyright Notice in gmMachine.h
+
+*/
+
+#ifndef _GMMACHINEPOOL_H_
+#define _GMMACHINEPOOL_H_
+
+#include "gmConfig.h"
+#include "gmVariable.h"
+
+#include <condition_variable>
+#include <mutex>
+
+class gmMachine;
+class gmThread;
+struct gmMachinePoolWorker;
+
+/// \brief gmMachinePoolInitCallback is called for each machine on its own OS thread as the pool opens, to bind libs
+///        and run scripts.
+/// \return false to fail gmMachinePool::Open().
+typedef bool (GM_CDECL * gmMachinePoolInitCallback)(gmMachine * a_machine, int a_index, void * a_user);
+
+/// \class gmMachinePool
+/// \brief gmMachinePool runs a number of gmMachines, each on its own OS thread with its own heap and gc.  Machines
+///        share nothing, and talk by posting values (int, float, string and flat tables of those) which are copied
+///        into a lock free queue on the receiving machine.  Posted values are delivered to the receiving machine's
+///        mailbox as it starts its next Execute(), and a posted signal is raised there with gmMachine::Signal(), so
+///        scripts wait for messages with block() as they would for any other signal.  See gmBindMachinePoolLib().
+class gmMachinePool
+{
+public:
+
+    gmMachinePool();
+    ~gmMachinePool();
+
+    /// \brief Open() will create a_numMachines machines, each with its own OS thread, and call a_init on each.
+    bool Open(int a_numMachines, gmMachinePoolInitCallback a_init = NULL, void* a_user = NULL);
+
+    /// \brief Close() will stop the OS threads, and destroy the machines along with any undelivered messages.
+    void Close();
+
+    inline int GetNumMachines() const { return m_numWorkers; }
+
+    /// \brief GetMachine() will return a machine.  Only touch it from the host while the pool is not executing.
+    gmMachine* GetMachine(int a_index) const;
+
+    /// \brief Execute() will run gmMachine::Execute(a_delta) on every machine at once, and wait for them all.
+    /// \return the number of script threads left on all machines.
+    int Execute(gmuint32 a_delta);
+
+    /// \brief Post() will copy a value and or a signal into the queue of machine a_to.  Safe from any OS thread.
+    /// \param a_from is the machine that owns any string or table in a_value or a_signal, it must be the caller's own
+    ///        machine, or a pool machine while the pool is not executing.
+    /// \param a_value is delivered to the mailbox of a_to, null to post only the signal.
+    /// \param a_signal is an int, float or string raised on a_to after a_value is delivered, may be NULL.
+    /// \return false if a_to is not in the pool or a value can not be posted.
+    bool Post(int a_to, gmMachine* a_from, const gmVariable& a_value, const gmVariable* a_signal = NULL);
+
+    /// \brief GetCurrent() will return the pool of the machine that runs on the calling OS thread, or NULL.
+    /// \param a_index if not NULL, is set to the index of that machine.
+    static gmMachinePool* GetCurrent(int* a_index = NULL);
+
+    /// \brief Receive() will push the oldest value in the mailbox of the calling OS thread's machine onto the
+    ///        thread, see GetCurrent().
+    /// \return false if the mailbox is empty, and nothing was pushed.
+    static bool Receive(gmThread* a_thread);
+
+private:
+
+    static void Run(gmMachinePoolWorker* a_worker);
+    void Done(gmMachinePoolWorker* a_worker, bool a_ok);
+
+    gmMachinePoolWorker* m_workers;
+    int m_numWorkers;
+    gmMachinePoolInitCallback m_init;
+    void* m_user;
+
+    // frames are started by bumping m_frame, and are done when m_numBusy drops to 0
+    std::mutex m_lock;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    gmuint32 m_frame;
+    gmuint32 m_delta;
+    int m_numBusy;
+    bool m_failed;
+    bool m_quit;
+};
+
+/// \brief gmBindMachinePoolLib() will bind the machine pool functions, machineIndex, machineCount, machineSend,
+///        machineSignal and machineReceive.  They do nothing useful on a machine outside a pool.
+void gmBindMachinePoolLib(gmMachine* a_machine);
+
+#endif // _GMMACHINEPOOL_H_
@@ -13,6 +13,328 @@
 #include "gmByteCode.h"
 
 
+int gmByteCodeOperandSize(gmuint32 a_byteCode)
+{
+  switch(a_byteCode)
+  {
+    case BC_GETDOT :
+    case BC_SETDOT :
+    case BC_BRA :
+    case BC_BRZ :
+    case BC_BRNZ :
+    case BC_BRZK :
+    case BC_BRNZK :
+    case BC_FOREACH :
+    case BC_PUSHINT :
+    case BC_PUSHSTR :
+    case BC_PUSHFN :
+    case BC_GETGLOBAL :
+    case BC_SETGLOBAL :
+    case BC_GETTHIS :
+    case BC_SETTHIS : return sizeof(gmptr);
+    case BC_PUSHFP : return sizeof(gmfloat);
+    case BC_CALL :
+    case BC_GETLOCAL :
+    case BC_SETLOCAL : return sizeof(gmuint32);
+    case BC_GETLOCAL8 :
+    case BC_SETLOCAL8 :
+    case BC_CALL8 :
+    case BC_PUSHINT8 : return sizeof(gmuint8);
+
+    // superinstructions have the operand of the first byte code in their sequence
+    case BC_GETLOCAL_GETLOCAL_ADD :
+    case BC_GETLOCAL_GETLOCAL_LT_BRZ :
+    case BC_GETLOCAL_PUSHINT_LT_BRZ :
+    case BC_GETLOCAL_OP :
+    case BC_PUSHINT_OP :
+    case BC_GETLOCAL_PUSHINT_OP : return sizeof(gmuint8);
+    case BC_GETTHIS_GETDOT : return sizeof(gmptr);
+
+    default : break;
+  }
+  return 0;
+}
+
+
+const char * gmGetByteCodeName(gmuint32 a_byteCode)
+{
+  switch(a_byteCode)
+  {
+    case BC_NOP : return "nop";
+    case BC_LINE : return "line";
+
+    case BC_GETDOT : return "get dot";
+    case BC_SETDOT : return "set dot";
+    case BC_GETIND : return "get index";
+    case BC_SETIND : return "set index";
+
+    case BC_BRA : return "bra";
+    case BC_BRZ : return "brz";
+    case BC_BRNZ : return "brnz";
+    case BC_BRZK : return "brzk";
+    case BC_BRNZK : return "brnzk";
+    case BC_CALL : return "call";
+    case BC_RET : return "ret";
+    case BC_RETV : return "retv";
+    case BC_FOREACH : return "foreach";
+    
+    case BC_POP : return "pop";
+    case BC_POP2 : return "pop2";
+    case BC_DUP : return "dup";
+    case BC_DUP2 : return "dup2";
+    case BC_SWAP : return "swap";
+    case BC_PUSHNULL : return "push null";
+    case BC_PUSHINT : return "push int";
+    case BC_PUSHINT0 : return "push int 0";
+    case BC_PUSHINT1 : return "push int 1";
+    case BC_PUSHFP : return "push fp";
+    case BC_PUSHSTR : return "push str";
+    case BC_PUSHTBL : return "push tbl";
+    case BC_PUSHFN : return "push fn";
+    case BC_PUSHTHIS : return "push this";
+    
+    case BC_GETLOCAL : return "get local";
+    case BC_SETLOCAL : return "set local";
+    case BC_GETGLOBAL : return "get global";
+    case BC_SETGLOBAL : return "set global";
+    case BC_GETTHIS : return "get this";
+    case BC_SETTHIS : return "set this";
+
+    case BC_GETLOCAL8 : return "get local 8";
+    case BC_SETLOCAL8 : return "set local 8";
+    case BC_CALL8 : return "call 8";
+    case BC_PUSHINT8 : return "push int 8";
+    
+    case BC_OP_ADD : return "add";
+    case BC_OP_SUB : return "sub";
+    case BC_OP_MUL : return "mul";
+    case BC_OP_DIV : return "div";
+    case BC_OP_REM : return "rem";
+
+    case BC_BIT_OR : return "bor";
+    case BC_BIT_XOR : return "bxor";
+    case BC_BIT_AND : return "band";
+    case BC_BIT_INV : return "binv";
+    case BC_BIT_SHL : return "bshl";
+    case BC_BIT_SHR : return "bshr";
+    
+    case BC_OP_NEG : return "neg";
+    case BC_OP_POS : return "pos";
+    case BC_OP_NOT : return "not";
+    
+    case BC_OP_LT : return "lt";
+    case BC_OP_GT : return "gt";
+    case BC_OP_LTE : return "lte";
+    case BC_OP_GTE : return "gte";
+    case BC_OP_EQ : return "eq";
+    case BC_OP_NEQ : return "neq";
+
+    case BC_GETLOCAL_GETLOCAL_ADD : return "get local, get local, add";
+    case BC_GETLOCAL_GETLOCAL_LT_BRZ : return "get local, get local, lt, brz";
+    case BC_GETLOCAL_PUSHINT_LT_BRZ : return "get local, push int, lt, brz";
+    case BC_PUSHINT1_ADD_SETLOCAL : return "push int 1, add, set local";
+    case BC_GETTHIS_GETDOT : return "get this, get dot";
+    case BC_GETLOCAL_OP : return "get local, op";
+    case BC_PUSHINT_OP : return "push int, op";
+    case BC_GETLOCAL_PUSHINT_OP : return "get local, push int, op";
+
+    default : break;
+  }
+  return "ERROR";
+}
+
+
+//
+// Compact byte code
+//
+
+// compact form of a 32 bit byte code and its operand
+static gmuint32 gmByteCodeCompactForm(gmuint32 a_byteCode, gmuint32 a_operand)
+{
+  switch(a_byteCode)
+  {
+    case BC_GETLOCAL : return (a_operand <= 0xff) ? (gmuint32) BC_GETLOCAL8 : a_byteCode;
+    case BC_SETLOCAL : return (a_operand <= 0xff) ? (gmuint32) BC_SETLOCAL8 : a_byteCode;
+    case BC_CALL : return (a_operand <= 0xff) ? (gmuint32) BC_CALL8 : a_byteCode;
+    case BC_PUSHINT : return ((gmint32) a_operand >= -128 && (gmint32) a_operand <= 127) ? (gmuint32) BC_PUSHINT8 : a_byteCode;
+    default : break;
+  }
+  return a_byteCode;
+}
+
+
+int gmByteCodeCompact(const void * a_byteCode, int a_byteCodeLength, void * a_compact, int * a_offsets)
+{
+  const gmuint32 * code = (const gmuint32 *) a_byteCode;
+  int length = a_byteCodeLength / sizeof(gmuint32);
+  int position, size = 0;
+
+  // internal byte codes never appear in 32 bit byte code, they and anything else unknown become nops, as do byte
+  // codes whose operand runs off the end.
+  for(position = 0; position < length;)
+  {
+    gmuint32 byteCode = code[position];
+    int operandWords = gmByteCodeOperandSize(byteCode) / sizeof(gmuint32);
+    if(byteCode >= BC_GETLOCAL8 || position + operandWords >= length)
+    {
+      a_offsets[position++] = size++;
+      continue;
+    }
+    byteCode = gmByteCodeCompactForm(byteCode, (operandWords) ? code[position + 1] : 0);
+    for(int i = 0; i <= operandWords; ++i)
+    {
+      a_offsets[position++] = size;
+    }
+    size += 1 + gmByteCodeOperandSize(byteCode);
+  }
+  a_offsets[length] = size;
+
+  if(a_compact == NULL)
+  {
+    return size;
+  }
+
+  gmuint8 * compact = (gmuint8 *) a_compact;
+  for(position = 0; position < length;)
+  {
+    gmuint32 byteCode = code[position];
+    int operandWords = gmByteCodeOperandSize(byteCode) / sizeof(gmuint32);
+    if(byteCode >= BC_GETLOCAL8 || position + operandWords >= length)
+    {
+      *(compact++) = BC_NOP;
+      ++position;
+      continue;
+    }
+    gmuint32 operand = (operandWords) ? code[position + 1] : 0;
+    byteCode = gmByteCodeCompactForm(byteCode, operand);
+    *(compact++) = (gmuint8) byteCode;
+
+    switch(byteCode)
+    {
+      case BC_GETLOCAL8 :
+      case BC_SETLOCAL8 :
+      case BC_CALL8 :
+      case BC_PUSHINT8 :
+      {
+        *(compact++) = (gmuint8) operand;
+        break;
+      }
+      case BC_BRA :
+      case BC_BRZ :
+      case BC_BRNZ :
+      case BC_BRZK :
+      case BC_BRNZK :
+        // branch targets are offsets from the start of the byte code, those outside it are left alone
+        if(operand / sizeof(gmuint32) <= (gmuint32) length)
+        {
+          operand = (gmuint32) a_offsets[operand / sizeof(gmuint32)];
+        }
+        // fall through
+      default :
+      {
+        if(operandWords)
+        {
+          memcpy(compact, &operand, sizeof(gmuint32));
+          compact += sizeof(gmuint32);
+        }
+        break;
+      }
+    }
+    position += 1 + operandWords;
+  }
+  return size;
+}
+
+
+//
+// Superinstructions
+//
+
+struct gmSuperInstruction
+{
+  gmuint32 m_byteCode;
+  int m_length;
+  gmuint32 m_sequence[4];
+};
+
+// in a sequence, matches any int operator the register operand superinstructions evaluate
+#define BC_ANY_OPERATOR BC_NUMBYTECODES
+
+static bool gmByteCodeIsFusedOperator(gmuint32 a_byteCode)
+{
+  switch(a_byteCode)
+  {
+    case BC_OP_ADD :
+    case BC_OP_SUB :
+    case BC_OP_MUL :
+    case BC_OP_DIV :
+    case BC_OP_REM :
+    case BC_BIT_OR :
+    case BC_BIT_XOR :
+    case BC_BIT_AND :
+    case BC_BIT_SHL :
+    case BC_BIT_SHR :
+    case BC_OP_LT :
+    case BC_OP_GT :
+    case BC_OP_LTE :
+    case BC_OP_GTE :
+    case BC_OP_EQ :
+    case BC_OP_NEQ : return true;
+    default : break;
+  }
+  return false;
+}
+
+// longest sequences first
+static const gmSuperInstruction s_superInstructions[] =
+{
+  { BC_GETLOCAL_GETLOCAL_LT_BRZ, 4, { BC_GETLOCAL8, BC_GETLOCAL8, BC_OP_LT, BC_BRZ } },
+  { BC_GETLOCAL_PUSHINT_LT_BRZ, 4, { BC_GETLOCAL8, BC_PUSHINT8, BC_OP_LT, BC_BRZ } },
+  { BC_GETLOCAL_PUSHINT_LT_BRZ, 4, { BC_GETLOCAL8, BC_PUSHINT, BC_OP_LT, BC_BRZ } },
+  { BC_GETLOCAL_GETLOCAL_ADD, 3, { BC_GETLOCAL8, BC_GETLOCAL8, BC_OP_ADD } },
+  { BC_PUSHINT1_ADD_SETLOCAL, 3, { BC_PUSHINT1, BC_OP_ADD, BC_SETLOCAL8 } },
+  { BC_GETTHIS_GETDOT, 2, { BC_GETTHIS, BC_GETDOT } },
+#if GMFUNCTION_REGISTEROPERANDS
+  { BC_GETLOCAL_PUSHINT_OP, 3, { BC_GETLOCAL8, BC_PUSHINT8, BC_ANY_OPERATOR } },
+  { BC_GETLOCAL_OP, 2, { BC_GETLOCAL8, BC_ANY_OPERATOR } },
+  { BC_PUSHINT_OP, 2, { BC_PUSHINT8, BC_ANY_OPERATOR } },
+#endif // GMFUNCTION_REGISTEROPERANDS
+};
+
+
+void gmByteCodeFuse(void * a_compact, int a_compactLength)
+{
+  gmuint8 * code = (gmuint8 *) a_compact;
+  int position = 0;
+
+  while(position < a_compactLength)
+  {
+    int next = position + 1 + gmByteCodeOperandSize(code[position]);
+    int i;
+
+    for(i = 0; i < (int) (sizeof(s_superInstructions) / sizeof(s_superInstructions[0])); ++i)
+    {
+      const gmSuperInstruction &superInstruction = s_superInstructions[i];
+      int at = position, j;
+      for(j = 0; j < superInstruction.m_length && at < a_compactLength; ++j)
+      {
+        gmuint32 byteCode = superInstruction.m_sequence[j];
+        if(code[at] != byteCode && !(byteCode == BC_ANY_OPERATOR && gmByteCodeIsFusedOperator(code[at]))) break;
+        at += 1 + gmByteCodeOperandSize(code[at]);
+      }
+      if(j == superInstruction.m_length && at <= a_compactLength)
+      {
+        code[position] = (gmuint8) superInstruction.m_byteCode;
+        break;
+      }
+    }
+
+    // carry on with the next byte code, sequences inside a fused sequence are fused too
+    position = next;
+  }
+}
+
+
 #if GM_COMPILE_DEBUG
 
 void gmByteCodePrint(FILE * a_fp, const void * a_byteCode, int a_byteCodeLength)
@@ -26,94 +348,20 @@ void gmByteCodePrint(FILE * a_fp, const void * a_byteCode, int a_byteCodeLength)
   instruction = (const gmuint8 *) a_byteCode;
   const gmuint8 * end = instruction + a_byteCodeLength;
   const gmuint8 * start = instruction;
-  const char * cp;
-  bool opiptr, opf32;
 
   while(instruction < end)
   {
-    opiptr = false;
-    opf32 = false;
-
     int addr = instruction - start;
+    gmuint32 byteCode = *(instruction32++);
+    const char * cp = gmGetByteCodeName(byteCode);
 
-    switch(*instruction)
-    {
-      case BC_NOP : cp = "nop"; break;
-      case BC_LINE : cp = "line"; break;
-
-      case BC_GETDOT : cp = "get dot"; opiptr = true; break;
-      case BC_SETDOT : cp = "set dot"; opiptr = true; break;
-      case BC_GETIND : cp = "get index"; break;
-      case BC_SETIND : cp = "set index"; break;
-
-      case BC_BRA : cp = "bra"; opiptr = true; break;
-      case BC_BRZ : cp = "brz"; opiptr = true; break;
-      case BC_BRNZ : cp = "brnz"; opiptr = true; break;
-      case BC_BRZK : cp = "brzk"; opiptr = true; break;
-      case BC_BRNZK : cp = "brnzk"; opiptr = true; break;
-      case BC_CALL : cp = "call"; opiptr = true; break;
-      case BC_RET : cp = "ret"; break;
-      case BC_RETV : cp = "retv"; break;
-      case BC_FOREACH : cp = "foreach"; opiptr = true; break;
-      
-      case BC_POP : cp = "pop"; break;
-      case BC_POP2 : cp = "pop2"; break;
-      case BC_DUP : cp = "dup"; break;
-      case BC_DUP2 : cp = "dup2"; break;
-      case BC_SWAP : cp = "swap"; break;
-      case BC_PUSHNULL : cp = "push null"; break;
-      case BC_PUSHINT : cp = "push int"; opiptr = true; break;
-      case BC_PUSHINT0 : cp = "push int 0"; break;
-      case BC_PUSHINT1 : cp = "push int 1"; break;
-      case BC_PUSHFP : cp = "push fp"; opf32 = true; break;
-      case BC_PUSHSTR : cp = "push str"; opiptr = true; break;
-      case BC_PUSHTBL : cp = "push tbl"; break;
-      case BC_PUSHFN : cp = "push fn"; opiptr = true; break;
-      case BC_PUSHTHIS : cp = "push this"; break;
-      
-      case BC_GETLOCAL : cp = "get local"; opiptr = true; break;
-      case BC_SETLOCAL : cp = "set local"; opiptr = true; break;
-      case BC_GETGLOBAL : cp = "get global"; opiptr = true; break;
-      case BC_SETGLOBAL : cp = "set global"; opiptr = true; break;
-      case BC_GETTHIS : cp = "get this"; opiptr = true; break;
-      case BC_SETTHIS : cp = "set this"; opiptr = true; break;
-      
-      case BC_OP_ADD : cp = "add"; break;
-      case BC_OP_SUB : cp = "sub"; break;
-      case BC_OP_MUL : cp = "mul"; break;
-      case BC_OP_DIV : cp = "div"; break;
-      case BC_OP_REM : cp = "rem"; break;
-
-      case BC_BIT_OR : cp = "bor"; break;
-      case BC_BIT_XOR : cp = "bxor"; break;
-      case BC_BIT_AND : cp = "band"; break;
-      case BC_BIT_INV : cp = "binv"; break;
-      case BC_BIT_SHL : cp = "bshl"; break;
-      case BC_BIT_SHR : cp = "bshr"; break;
-      
-      case BC_OP_NEG : cp = "neg"; break;
-      case BC_OP_POS : cp = "pos"; break;
-      case BC_OP_NOT : cp = "not"; break;
-      
-      case BC_OP_LT : cp = "lt"; break;
-      case BC_OP_GT : cp = "gt"; break;
-      case BC_OP_LTE : cp = "lte"; break;
-      case BC_OP_GTE : cp = "gte"; break;
-      case BC_OP_EQ : cp = "eq"; break;
-      case BC_OP_NEQ : cp = "neq"; break;
-
-      default : cp = "ERROR"; break;
-    }
-
-    ++instruction32;
-
-    if(opf32)
+    if(byteCode == BC_PUSHFP)
     {
       float fval = *((float *) instruction);
       instruction += sizeof(gmint32);
       fprintf(a_fp, "  %04d %s %f" GM_NL, addr, cp, fval);
     }
-    else if (opiptr)
+    else if (gmByteCodeOperandSize(byteCode))
     {
       gmptr ival = *((gmptr *) instruction);
       instruction += sizeof(gmptr);
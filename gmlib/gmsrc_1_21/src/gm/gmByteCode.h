@@ -17,6 +17,10 @@
 /// \enum gmByteCode
 /// \brief gmByteCode are the op codes for the game monkey scripting.  The first byte codes MUST match the gmOperator
 ///        enum.
+///
+///        The compiler and libs use 32 bit byte codes, each followed by its 32 bit operand if it has one.  Functions
+///        run compact byte code made from this by gmByteCodeCompact(), where each byte code is a single byte followed
+///        by its operand of gmByteCodeOperandSize() bytes, unaligned.
 enum gmByteCode
 {
   // BC_GETDOT to BC_NOP MUST MATCH ENUM GMOPERATOR
@@ -91,8 +95,47 @@ enum gmByteCode
   BC_SETGLOBAL,       // set global opptr (symbol id) --tos
   BC_GETTHIS,         // get this opptr (symbol id) ++tos
   BC_SETTHIS,         // set this opptr (symbol id) --tos
+
+  // compact forms, never compiled or written to libs.  gmByteCodeCompact() uses them for operands that fit in a byte.
+  BC_GETLOCAL8,       // get local op8 (stack offset) ++tos
+  BC_SETLOCAL8,       // set local op8 (stack offset) --tos
+  BC_CALL8,           // call op8 num parameters
+  BC_PUSHINT8,        // push int op8 (signed)
+
+  // superinstructions, never compiled or written to libs.  gmByteCodeFuse() makes them in compact byte code from the
+  // sequences they are named after.  each replaces the first byte code of its sequence and leaves the rest in place,
+  // so byte code offsets do not change and a branch into the middle of a sequence still finds the original.
+  BC_GETLOCAL_GETLOCAL_ADD,
+  BC_GETLOCAL_GETLOCAL_LT_BRZ,
+  BC_GETLOCAL_PUSHINT_LT_BRZ,
+  BC_PUSHINT1_ADD_SETLOCAL,
+  BC_GETTHIS_GETDOT,
+
+  // register operand superinstructions.  these take an operand of an int operator straight from a local or the byte
+  // code instead of from the stack.  OP is any of the operators gmByteCodeFuse() allows, the handler reads it.
+  BC_GETLOCAL_OP,          // get local, op.  tos OP local
+  BC_PUSHINT_OP,           // push int, op.  tos OP int
+  BC_GETLOCAL_PUSHINT_OP,  // get local, push int, op.  push local OP int
+
+  BC_NUMBYTECODES,    // not a byte code, the number of byte codes
 };
 
+/// \brief gmByteCodeOperandSize() will return the size of the operand following a byte code, 0 for none.
+int gmByteCodeOperandSize(gmuint32 a_byteCode);
+
+/// \brief gmByteCodeCompact() will translate 32 bit byte code to compact byte code, with branch targets re-based.
+/// \param a_compact receives the compact byte code, or is NULL to only get its size.
+/// \param a_offsets receives the compact offset of each 32 bit word of a_byteCode, and of its end, so must hold
+///        a_byteCodeLength / 4 + 1 entries.  a word within an operand gets the offset of its byte code.
+/// \return the size of the compact byte code.
+int gmByteCodeCompact(const void * a_byteCode, int a_byteCodeLength, void * a_compact, int * a_offsets);
+
+/// \brief gmGetByteCodeName() will return the name of a byte code as printed by gmByteCodePrint().
+const char * gmGetByteCodeName(gmuint32 a_byteCode);
+
+/// \brief gmByteCodeFuse() will replace common compact byte code sequences with superinstructions, in place.
+void gmByteCodeFuse(void * a_compact, int a_compactLength);
+
 #if GM_COMPILE_DEBUG
 
 void gmByteCodePrint(FILE * a_fp, const void * a_byteCode, int a_byteCodeLength);
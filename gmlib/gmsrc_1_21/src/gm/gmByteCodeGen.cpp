@@ -147,6 +147,9 @@ void gmByteCodeGen::AdjustStack(gmByteCode a_instruction)
     case BC_OP_GTE : --m_tos; break;
     case BC_OP_EQ : --m_tos; break;
     case BC_OP_NEQ : --m_tos; break;
+
+    // fused and compact forms are made after code generation, never emitted here
+    default : break;
   }
 
   if(m_tos > m_maxTos) m_maxTos = m_tos;
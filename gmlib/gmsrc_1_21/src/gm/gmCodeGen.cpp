@@ -14,6 +14,7 @@
 #include "gmByteCodeGen.h"
 #include "gmArraySimple.h"
 #include "gmListDouble.h"
+#include "gmHash.h"
 
 static const char * s_tempVarName0 = "__t0";
 static const char * s_tempVarName1 = "__t1";
@@ -25,21 +26,30 @@ static void gmSortDebugLines(gmArraySimple<gmLineInfo> &a_lineInfo)
 {
   int count = a_lineInfo.Count();
 
-  // sort by address
+  // byte code is emitted in address order, so the entries are usually sorted already
   int i;
-  for(i = 0; i < count; ++i)
+  for(i = 1; i < count; ++i)
   {
-    int min = i, j;
-    for(j = i + 1; j < count; ++j)
+    if(a_lineInfo[i].m_address < a_lineInfo[i - 1].m_address) break;
+  }
+
+  // sort by address
+  if(i < count)
+  {
+    for(i = 0; i < count; ++i)
     {
-      if(a_lineInfo[j].m_address < a_lineInfo[min].m_address) 
+      int min = i, j;
+      for(j = i + 1; j < count; ++j)
       {
-        min = j;
+        if(a_lineInfo[j].m_address < a_lineInfo[min].m_address) 
+        {
+          min = j;
+        }
       }
+      gmLineInfo t = a_lineInfo[min];
+      a_lineInfo[min] = a_lineInfo[i];
+      a_lineInfo[i] = t;
     }
-    gmLineInfo t = a_lineInfo[min];
-    a_lineInfo[min] = a_lineInfo[i];
-    a_lineInfo[i] = t;
   }
 
   // remove duplicate line numbers
@@ -108,6 +118,7 @@ public:
   gmLog * m_log;
   gmCodeGenHooks * m_hooks;
   bool m_debug;
+  int m_lastLine; //!< line of the last emitted BC_LINE
 
   // Variable
   struct Variable
@@ -129,9 +140,14 @@ public:
     // return -2 if the variable does not exist, -1 if it exists but is not a local
     // set a type to var type if return >= -1
     int GetVariableOffset(const char * a_symbol, gmCodeTreeVariableType &a_type);
+    // return the index of the variable in m_variables, or -1 if it does not exist
+    int FindVariable(const char * a_symbol);
+    // add the last variable to the hash, building it once there are more than GMCODEGEN_VARIABLEHASHMIN
+    void HashLastVariable();
 
     const char * m_debugName; // name of the variable the function is assigned to.
     gmArraySimple<Variable> m_variables;
+    gmArraySimple<int> m_variableHash; // open addressed m_variables indices, -1 for empty slots, empty while there are few variables
     int m_numLocals; // number of local variables including parameters.
     gmByteCodeGen m_byteCode;
 
@@ -200,6 +216,13 @@ gmCodeGen& gmCodeGen::Get()
 
 
 
+gmCodeGen * gmCodeGen::Create()
+{
+  return new gmCodeGenPrivate;
+}
+
+
+
 //
 //
 // Implementation of gmCodeGenPrivate
@@ -213,6 +236,7 @@ gmCodeGenPrivate::gmCodeGenPrivate()
   m_log = NULL;
   m_hooks = NULL;
   m_debug = false;
+  m_lastLine = 0;
 
   m_currentLoop = NULL;
   m_currentFunction = NULL;
@@ -251,6 +275,7 @@ int gmCodeGenPrivate::Lock(const gmCodeTreeNode * a_codeTree, gmCodeGenHooks * a
   m_log = a_log;
   m_hooks = a_hooks;
   m_debug = a_debug;
+  m_lastLine = 0;
 
   GM_ASSERT(m_hooks != NULL);
 
@@ -343,15 +368,14 @@ bool gmCodeGenPrivate::Generate(const gmCodeTreeNode * a_node, gmByteCodeGen * a
   while(a_node)
   {
     // record line number
-    static int s_line = 0;
     if(m_currentFunction) m_currentFunction->m_currentLine = a_node->m_lineNumber;
 
     // if we are in debug, emit a BC_LINE instruction
-    if(m_debug && (s_line != a_node->m_lineNumber) && 
+    if(m_debug && (m_lastLine != a_node->m_lineNumber) && 
        !(a_node->m_type == CTNT_STATEMENT && a_node->m_subType == CTNST_COMPOUND))
     {
       a_byteCode->Emit(BC_LINE);
-      s_line = a_node->m_lineNumber;
+      m_lastLine = a_node->m_lineNumber;
     }
 
     switch(a_node->m_type)
@@ -1387,6 +1411,7 @@ void gmCodeGenPrivate::FunctionState::Reset()
 {
   m_debugName = NULL;
   m_variables.Reset();
+  m_variableHash.Reset();
   m_numLocals = 0;
   m_currentLine = 1;
   m_byteCode.Reset(this);
@@ -1397,18 +1422,16 @@ void gmCodeGenPrivate::FunctionState::Reset()
 
 int gmCodeGenPrivate::FunctionState::GetVariableOffset(const char * a_symbol, gmCodeTreeVariableType &a_type)
 {
-  for(gmuint v = 0; v < m_variables.Count(); ++v)
+  int index = FindVariable(a_symbol);
+  if(index >= 0)
   {
-    Variable &variable = m_variables[v];
-    if(strcmp(variable.m_symbol, a_symbol) == 0)
+    Variable &variable = m_variables[index];
+    a_type = variable.m_type;
+    if(variable.m_type == CTVT_LOCAL)
     {
-      a_type = variable.m_type;
-      if(variable.m_type == CTVT_LOCAL)
-      {
-        return variable.m_offset;
-      }
-      return -1;
+      return variable.m_offset;
     }
+    return -1;
   }
 
   a_type = CTVT_GLOBAL;
@@ -1419,19 +1442,17 @@ int gmCodeGenPrivate::FunctionState::GetVariableOffset(const char * a_symbol, gm
 
 int gmCodeGenPrivate::FunctionState::SetVariableType(const char * a_symbol, gmCodeTreeVariableType a_type)
 {
-  for(gmuint v = 0; v < m_variables.Count(); ++v)
+  int index = FindVariable(a_symbol);
+  if(index >= 0)
   {
-    Variable &variable = m_variables[v];
-    if(strcmp(variable.m_symbol, a_symbol) == 0)
+    Variable &variable = m_variables[index];
+    variable.m_type = a_type;
+    // if this variable was previously not a local, be is now being declared as local, get a stack offset.
+    if(a_type == CTVT_LOCAL && variable.m_offset == -1)
     {
-      variable.m_type = a_type;
-      // if this variable was previously not a local, be is now being declared as local, get a stack offset.
-      if(a_type == CTVT_LOCAL && variable.m_offset == -1)
-      {
-        variable.m_offset = m_numLocals++;
-      }
-      return variable.m_offset;
+      variable.m_offset = m_numLocals++;
     }
+    return variable.m_offset;
   }
 
   Variable &variable = m_variables.InsertLast();
@@ -1444,11 +1465,76 @@ int gmCodeGenPrivate::FunctionState::SetVariableType(const char * a_symbol, gmCo
 
   variable.m_type = a_type;
   variable.m_symbol = a_symbol;
+  HashLastVariable();
   return variable.m_offset;
 }
 
 
 
+int gmCodeGenPrivate::FunctionState::FindVariable(const char * a_symbol)
+{
+  gmuint size = m_variableHash.Count();
+  if(size == 0)
+  {
+    for(gmuint v = 0; v < m_variables.Count(); ++v)
+    {
+      if(strcmp(m_variables[v].m_symbol, a_symbol) == 0)
+      {
+        return (int) v;
+      }
+    }
+    return -1;
+  }
+
+  gmuint slot = gmDefaultHasher::Hash(a_symbol) & (size - 1);
+  while(m_variableHash[slot] != -1)
+  {
+    if(strcmp(m_variables[m_variableHash[slot]].m_symbol, a_symbol) == 0)
+    {
+      return m_variableHash[slot];
+    }
+    slot = (slot + 1) & (size - 1);
+  }
+  return -1;
+}
+
+
+
+void gmCodeGenPrivate::FunctionState::HashLastVariable()
+{
+  gmuint count = m_variables.Count();
+  if(count <= GMCODEGEN_VARIABLEHASHMIN)
+  {
+    return;
+  }
+
+  // keep the hash at most half full, rehashing every variable when it grows.
+  gmuint size = m_variableHash.Count();
+  gmuint first = count - 1;
+  if(count * 2 > size)
+  {
+    size = (size) ? size * 2 : GMCODEGEN_VARIABLEHASHMIN * 4;
+    m_variableHash.SetCount(size);
+    for(gmuint slot = 0; slot < size; ++slot)
+    {
+      m_variableHash[slot] = -1;
+    }
+    first = 0;
+  }
+
+  for(gmuint v = first; v < count; ++v)
+  {
+    gmuint slot = gmDefaultHasher::Hash(m_variables[v].m_symbol) & (size - 1);
+    while(m_variableHash[slot] != -1)
+    {
+      slot = (slot + 1) & (size - 1);
+    }
+    m_variableHash[slot] = (int) v;
+  }
+}
+
+
+
 gmCodeGenPrivate::FunctionState * gmCodeGenPrivate::PushFunction()
 {
   if(m_currentFunction)
@@ -27,9 +27,14 @@ class gmCodeGen
 {
 public:
 
-  /// \brief Get() will return the singleton code generator.
+  virtual ~gmCodeGen() {}
+
+  /// \brief Get() will return the shared default code generator.
   static gmCodeGen& Get();
 
+  /// \brief Create() will return a new code generator, independent of Get(), for the caller to delete.
+  static gmCodeGen * Create();
+
   /// \brief FreeMemory() will free all memory allocated by the code tree.  must be unlocked
   virtual void FreeMemory() = 0;
 
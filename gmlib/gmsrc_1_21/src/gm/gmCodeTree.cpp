@@ -13,14 +13,15 @@
 #include "gmCodeTree.h"
 #include <ctype.h>
 
-gmCodeTreeNode * g_codeTree = NULL;
+GM_THREAD_LOCAL gmCodeTreeNode * g_codeTree = NULL;
+static GM_THREAD_LOCAL gmCodeTree * s_parsing = NULL; // code tree the parser is building on this thread
 
 
 
 gmCodeTree::gmCodeTree() :
   m_mem(1, GMCODETREE_CHAINSIZE)
 {
-  g_codeTree = NULL;
+  m_codeTree = NULL;
   m_locked = false;
   m_errors = 0;
   m_log = 0;
@@ -37,6 +38,10 @@ gmCodeTree::~gmCodeTree()
 
 gmCodeTree &gmCodeTree::Get()
 {
+  if(s_parsing)
+  {
+    return *s_parsing;
+  }
   static gmCodeTree codeTree;
   return codeTree;
 }
@@ -60,6 +65,7 @@ int gmCodeTree::Lock(const char * a_script, gmLog * a_log)
   m_errors = 0;
   m_locked = true;
   m_log = a_log;
+  m_codeTree = NULL;
   g_codeTree = NULL;
   //gmdebug = 1;
   gmlineno = 1;
@@ -68,9 +74,14 @@ int gmCodeTree::Lock(const char * a_script, gmLog * a_log)
   YY_BUFFER_STATE buffer = gm_scan_string(a_script);
   if(buffer)
   {
+    gmCodeTree * parsing = s_parsing;
+    s_parsing = this;
     m_errors = gmparse();
+    s_parsing = parsing;
     gm_delete_buffer(buffer);
   }
+  m_codeTree = g_codeTree;
+  g_codeTree = NULL;
   return m_errors;
 }
 
@@ -79,7 +90,7 @@ int gmCodeTree::Lock(const char * a_script, gmLog * a_log)
 int gmCodeTree::Unlock()
 {
   m_mem.Reset();
-  g_codeTree = NULL;
+  m_codeTree = NULL;
   m_locked = false;
   m_errors = 0;
   m_log = NULL;
@@ -90,7 +101,7 @@ int gmCodeTree::Unlock()
 
 const gmCodeTreeNode * gmCodeTree::GetCodeTree() const
 {
-  return g_codeTree;
+  return m_codeTree;
 }
 
 
@@ -260,7 +271,7 @@ void gmCodeTree::Print(FILE * a_fp)
 {
   if(m_locked)
   {
-    PrintRecursive(g_codeTree, a_fp, true);
+    PrintRecursive(m_codeTree, a_fp, true);
   }
 }
 
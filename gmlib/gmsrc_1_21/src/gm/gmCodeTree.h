@@ -24,16 +24,15 @@
 struct gmCodeTreeNode;
 
 /// \class gmCodeTree
-/// \brief gmCodeTree is a singleton class for creating code trees.
+/// \brief gmCodeTree creates code trees.  Each gmMachine owns its own code tree, so separate machines may
+///        parse on separate threads.
 class gmCodeTree
 {
-protected:
-  gmCodeTree();
-
 public:
+  gmCodeTree();
   ~gmCodeTree();
 
-  /// \brief Get() will return the singlton parser.
+  /// \brief Get() will return the code tree currently parsing on this thread, or the shared default parser.
   static gmCodeTree &Get();
 
   /// \brief FreeMemory() will free all memory allocated by the code tree.  must be unlocked
@@ -77,6 +76,7 @@ private:
   int m_errors;
   gmLog * m_log;
   gmMemChain m_mem;
+  gmCodeTreeNode * m_codeTree;
 };
 
 
@@ -237,6 +237,7 @@ struct gmCodeTreeNode
   gmCodeTreeNode * m_children[GMCODETREE_NUMCHILDREN];
   gmCodeTreeNode * m_sibling;
   gmCodeTreeNode * m_parent;
+  gmCodeTreeNode * m_lastSibling; // parser use only, a node near the end of the sibling list this node heads
 
   int m_lineNumber;
   gmCodeTreeNodeData m_data;
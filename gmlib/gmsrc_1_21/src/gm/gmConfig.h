@@ -102,11 +102,35 @@ enum gmEndian
 // COMPILER CODE GENERATOR
 
 #define GM_COMPILE_PASS_THIS_ALWAYS 0         // set to 1 to pass current this to each function call
+#define GMLIBHOOKS_SYMBOLHASHSIZE   256       // initial hash size for finding duplicate strings when writing a lib, grows with the strings
+#define GMCODEGEN_VARIABLEHASHMIN   16        // functions with more variables than this find them through a hash
 
 // RUNTIME THREAD
 
 #define GMTHREAD_INITIALBYTESIZE    512       // initial stack byte size for a single thread
 #define GMTHREAD_MAXBYTESIZE        128000    //1024  // max stack byte size for a single thread (Sample scripts like it big)
+#define GMTHREAD_INITIALFRAMES      16        // initial size of the call frame array for a single thread
+#ifndef GMTHREAD_THREADEDDISPATCH
+#define GMTHREAD_THREADEDDISPATCH   0         // 1 to dispatch byte code through a table of label addresses (gcc and clang only)
+#endif
+
+// RUNTIME FUNCTION
+
+#ifndef GMFUNCTION_SUPERINSTRUCTIONS
+#define GMFUNCTION_SUPERINSTRUCTIONS 1        // fuse common byte code sequences as functions are loaded, see gmByteCodeFuse()
+#endif
+
+#ifndef GMFUNCTION_REGISTEROPERANDS
+#define GMFUNCTION_REGISTEROPERANDS 1         // fuse int operators with their local or small int operand, needs GMFUNCTION_SUPERINSTRUCTIONS
+#endif
+
+#ifndef GMFUNCTION_GLOBALCACHE
+#define GMFUNCTION_GLOBALCACHE 1              // give each global get and set an inline cache of its global table node
+#endif
+
+#ifndef GMFUNCTION_MEMBERCACHE
+#define GMFUNCTION_MEMBERCACHE 1              // give each table member get and set an inline cache of its node index
+#endif
 
 // MACHINE
 
@@ -114,13 +138,13 @@ enum gmEndian
 #define GMMACHINE_OBJECTCHUNKSIZE   32        // default object chunk allocation size
 #define GMMACHINE_TBLCHUNKSIZE      32        // table object chunk allocation size
 #define GMMACHINE_STRINGCHUNKSIZE   128       // default object chunk allocation size
-#define GMMACHINE_STACKFCHUNKSIZE   128       // stack frame chunk size
 #define GMMACHINE_AUTOMEM           true      // automatically decide garbage collection limit
 #define GMMACHINE_AUTOMEMMULTIPY    2.5f      // after gc cycle, set limit = current * GMMACHINE_AUTOMEMMULTIPY (This is for atomic GC)
 #define GMMACHINE_INITIALGCHARDLIMIT 128*1024  // default gc hard memory limit.
 #define GMMACHINE_INITIALGCSOFTLIMIT (GMMACHINE_INITIALGCHARDLIMIT * 9 / 10) // default gc soft memory limit
 #define GMMACHINE_STRINGHASHSIZE    8192      // this will be dynamic... todo
-#define GMMACHINE_MAXKILLEDTHREADS  16        // max size of the free thread list (don't make too large, ie, < 32)
+#define GMMACHINE_MAXKILLEDTHREADS  16        // default max size of the free thread list, see gmMachine::SetMaxFreeThreads()
+#define GMMACHINE_THREADTRIMTIME    1000      // machine milliseconds between trims of unused free threads
 #define GMMACHINE_GCEVERYALLOC      0         // define this to check garbage collection every allocate.
 #define GMMACHINE_SUPERPARANOIDGC   0         // validate references (only for debugging purposes)
 #define GMMACHINE_THREEPASSGC       0         // 1 for safe gc of persisting objects that reference other objects, 
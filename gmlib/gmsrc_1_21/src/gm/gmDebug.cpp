@@ -558,8 +558,8 @@ void gmMachineSetBreakPoint(gmDebugSession * a_session, int a_responseId, int a_
   const void * bp = (const void *) a_session->GetMachine()->GetInstructionAtBreakPoint(a_sourceId, a_lineNumber);
   if(bp)
   {
-    // get to next instruction
-    bp = (const void *) (((const char *) bp) + 4);
+    // get to next instruction, past the one byte line byte code
+    bp = (const void *) (((const char *) bp) + 1);
 
     int * id = a_session->FindBreakPoint(bp);
     if(id)
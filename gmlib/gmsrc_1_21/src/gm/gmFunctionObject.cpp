@@ -12,6 +12,7 @@
 #include "gmConfig.h"
 #include "gmFunctionObject.h"
 #include "gmMachine.h"
+#include "gmLibHooks.h"
 
 gmFunctionObject::gmFunctionObject()
 {
@@ -25,6 +26,8 @@ gmFunctionObject::gmFunctionObject()
   m_numParamsLocals = 0;
   m_numReferences = 0;
   m_references = NULL;
+  m_lib = NULL;
+  m_libOffset = 0;
 }
 
 void gmFunctionObject::Destruct(gmMachine * a_machine)
@@ -55,6 +58,11 @@ void gmFunctionObject::Destruct(gmMachine * a_machine)
     a_machine->Sys_Free(m_debugInfo);
     m_debugInfo = NULL;
   }
+  if(m_lib)
+  {
+    gmLibHooks::ReleaseLib(*a_machine, m_lib);
+    m_lib = NULL;
+  }
 
 #if GM_USE_INCGC
   a_machine->DestructDeleteObject(this);
@@ -95,17 +103,14 @@ void gmFunctionObject::Mark(gmMachine * a_machine, gmuint32 a_mark)
 
 bool gmFunctionObject::Init(gmMachine * a_machine, bool a_debug, gmFunctionInfo &a_info, gmuint32 a_sourceId)
 {
-  // byte code
+  // byte code is run compact, see gmByteCodeCompact().  offsets maps the 32 bit byte code to it for the line info.
+  int * offsets = NULL;
+  m_byteCode = NULL;
+  m_byteCodeLength = 0;
   if(a_info.m_byteCodeLength)
   {
-    m_byteCode = (gmuint8 *) a_machine->Sys_Alloc(a_info.m_byteCodeLength);
-    memcpy(m_byteCode, a_info.m_byteCode, a_info.m_byteCodeLength);
-    m_byteCodeLength = a_info.m_byteCodeLength;
-  }
-  else
-  {
-    m_byteCode = NULL;
-    m_byteCodeLength = 0;
+    offsets = (int *) malloc(sizeof(int) * (a_info.m_byteCodeLength / sizeof(gmuint32) + 1));
+    m_byteCodeLength = gmByteCodeCompact(a_info.m_byteCode, a_info.m_byteCodeLength, NULL, offsets);
   }
 
   // stack info
@@ -118,12 +123,13 @@ bool gmFunctionObject::Init(gmMachine * a_machine, bool a_debug, gmFunctionInfo
   m_numReferences = 0;
   m_references = NULL;
 
-  if(m_byteCode)
+  if(m_byteCodeLength)
   {
     // find the objects this function references by iterating over the byte code and collecting them.
     // we could perform this step in the compilation phase if we don't want to iterate over the byte code.
     
     gmptr * references = (gmptr *) malloc(a_info.m_byteCodeLength);
+    int numGlobals = 0, numMembers = 0;
 
     union
     {
@@ -131,31 +137,47 @@ bool gmFunctionObject::Init(gmMachine * a_machine, bool a_debug, gmFunctionInfo
       const gmuint32 * instruction32;
     };
 
-    instruction = (const gmuint8 *) m_byteCode;
-    const gmuint8 * end = instruction + m_byteCodeLength;
+    instruction = (const gmuint8 *) a_info.m_byteCode;
+    const gmuint8 * end = instruction + a_info.m_byteCodeLength;
     for(;instruction < end;)
     {
       switch(*(instruction32++))
       {
-        case BC_GETDOT :
-        case BC_SETDOT :
         case BC_BRA :
         case BC_BRZ :
         case BC_BRNZ :
         case BC_BRZK :
         case BC_BRNZK :
         case BC_FOREACH :
-        case BC_PUSHINT :
-        case BC_GETGLOBAL :
-        case BC_SETGLOBAL :
-        case BC_GETTHIS :
-        case BC_SETTHIS : instruction += sizeof(gmptr); break;
+        case BC_PUSHINT : instruction += sizeof(gmptr); break;
         case BC_PUSHFP : instruction += sizeof(gmfloat); break;
       
         case BC_CALL :
         case BC_GETLOCAL :
         case BC_SETLOCAL : instruction += sizeof(gmuint32); break;
 
+        case BC_GETGLOBAL :
+        case BC_SETGLOBAL :
+        {
+#if GMFUNCTION_GLOBALCACHE
+          ++numGlobals;
+#endif // GMFUNCTION_GLOBALCACHE
+          instruction += sizeof(gmptr);
+          break;
+        }
+
+        case BC_GETDOT :
+        case BC_SETDOT :
+        case BC_GETTHIS :
+        case BC_SETTHIS :
+        {
+#if GMFUNCTION_MEMBERCACHE
+          ++numMembers;
+#endif // GMFUNCTION_MEMBERCACHE
+          instruction += sizeof(gmptr);
+          break;
+        }
+
         case BC_PUSHSTR :
         case BC_PUSHFN :
         {
@@ -182,6 +204,67 @@ bool gmFunctionObject::Init(gmMachine * a_machine, bool a_debug, gmFunctionInfo
     }
 
     free(references);
+
+    // the inline caches follow the byte code, each cached instruction's operand becomes the offset of its cache.
+    int globalOffset = (m_byteCodeLength + sizeof(void *) - 1) & ~(int) (sizeof(void *) - 1);
+    int memberOffset = globalOffset + sizeof(gmTableCache) * numGlobals;
+    int size = (numGlobals > 0 || numMembers > 0) ? memberOffset + sizeof(gmTableMemberCache) * numMembers : m_byteCodeLength;
+    gmuint8 * start = (gmuint8 *) a_machine->Sys_Alloc(size);
+    gmByteCodeCompact(a_info.m_byteCode, a_info.m_byteCodeLength, start, offsets);
+    m_byteCode = start;
+
+    if(numGlobals > 0 || numMembers > 0)
+    {
+      gmTableCache * globalCache = (gmTableCache *) (start + globalOffset);
+      gmTableMemberCache * memberCache = (gmTableMemberCache *) (start + memberOffset);
+      gmuint8 * byteCode = start;
+      end = byteCode + m_byteCodeLength;
+      while(byteCode < end)
+      {
+        gmuint32 op = *(byteCode++);
+        gmuint8 * operand = byteCode;
+        byteCode += gmByteCodeOperandSize(op);
+        switch(op)
+        {
+#if GMFUNCTION_GLOBALCACHE
+          case BC_GETGLOBAL :
+          case BC_SETGLOBAL :
+          {
+            gmptr cacheOffset = (gmptr) ((gmuint8 *) globalCache - start);
+            globalCache->m_node = NULL;
+            globalCache->m_version = 0;
+            memcpy(&globalCache->m_key, operand, sizeof(gmptr));
+            memcpy(operand, &cacheOffset, sizeof(gmptr));
+            ++globalCache;
+            break;
+          }
+#endif // GMFUNCTION_GLOBALCACHE
+#if GMFUNCTION_MEMBERCACHE
+          case BC_GETDOT :
+          case BC_SETDOT :
+          case BC_GETTHIS :
+          case BC_SETTHIS :
+          {
+            gmptr cacheOffset = (gmptr) ((gmuint8 *) memberCache - start);
+            memcpy(&memberCache->m_key, operand, sizeof(gmptr));
+            int way;
+            for(way = 0; way < gmTableMemberCache::NUM_WAYS; ++way)
+            {
+              memberCache->m_index[way] = -1;
+            }
+            memcpy(operand, &cacheOffset, sizeof(gmptr));
+            ++memberCache;
+            break;
+          }
+#endif // GMFUNCTION_MEMBERCACHE
+          default : break;
+        }
+      }
+    }
+
+#if GMFUNCTION_SUPERINSTRUCTIONS
+    gmByteCodeFuse(m_byteCode, m_byteCodeLength);
+#endif // GMFUNCTION_SUPERINSTRUCTIONS
   }
   
   // debug info
@@ -222,8 +305,25 @@ bool gmFunctionObject::Init(gmMachine * a_machine, bool a_debug, gmFunctionInfo
       m_debugInfo->m_lineInfo = (gmLineInfo *) a_machine->Sys_Alloc(sizeof(gmLineInfo) * a_info.m_lineInfoCount);
       memcpy(m_debugInfo->m_lineInfo, a_info.m_lineInfo, sizeof(gmLineInfo) * a_info.m_lineInfoCount);
       m_debugInfo->m_lineInfoCount = a_info.m_lineInfoCount;
+
+      // addresses are into the 32 bit byte code, move them to the compact byte code
+      if(offsets)
+      {
+        int numWords = a_info.m_byteCodeLength / sizeof(gmuint32);
+        int i;
+        for(i = 0; i < a_info.m_lineInfoCount; ++i)
+        {
+          int word = m_debugInfo->m_lineInfo[i].m_address / sizeof(gmuint32);
+          m_debugInfo->m_lineInfo[i].m_address = offsets[(word < numWords) ? word : numWords];
+        }
+      }
     }
   }
+
+  if(offsets)
+  {
+    free(offsets);
+  }
   
   return true;
 }
@@ -276,8 +376,22 @@ gmuint32 gmFunctionObject::GetSourceId() const
   {
     return m_debugInfo->m_sourceId;
   }
+  if(m_lib)
+  {
+    return m_lib->m_sourceId;
+  }
   return 0;
 }
 
 
+bool gmFunctionObject::Bind(gmMachine * a_machine)
+{
+  if(m_lib)
+  {
+    return gmLibHooks::BindFunction(*a_machine, this);
+  }
+  return true;
+}
+
+
 
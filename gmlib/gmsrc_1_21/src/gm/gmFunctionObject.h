@@ -18,6 +18,7 @@
 
 // fwd decls
 class gmThread;
+struct gmLibImage;
 
 enum gmCFunctionReturn
 {
@@ -98,6 +99,12 @@ public:
   /// \brief GetSymbol() will return the symbol name at the given offset.
   inline const char * GetSymbol(int a_offset) const;
 
+  /// \brief IsBound() is false for functions from a lazily bound lib that have not been called yet.
+  inline bool IsBound() const { return m_lib == NULL; }
+
+  /// \brief Bind() will load the byte code of a function from a lazily bound lib.
+  bool Bind(gmMachine * a_machine);
+
   // public data
   gmCFunction m_cFunction;
 
@@ -124,6 +131,10 @@ private:
   int m_numParamsLocals; //!< m_numLocals + m_numParams
   int m_numReferences; //!< number of references within the byte code.
   gmptr * m_references; //!< references from the byte code
+  gmLibImage * m_lib; //!< lib holding the byte code when not yet bound
+  gmuint32 m_libOffset; //!< offset of the function within m_lib
+
+  friend class gmLibHooks;
 };
 
 //
@@ -96,7 +96,8 @@ public:
 
   // members
 
-  gmHash(gmuint a_size);
+  /// \param a_grow if true, the table doubles its slots whenever it holds more items than slots.
+  gmHash(gmuint a_size, bool a_grow = false);
   ~gmHash();
 
   void RemoveAll();
@@ -127,9 +128,11 @@ public:
 private:
 
   T * GetNext(T * a_elem) const { return a_elem->NQUAL::m_next; }
+  void Grow();
   T ** m_table;
   gmuint m_count;
   gmuint m_size;
+  bool m_grow;
 
   friend class Iterator;
 };
@@ -183,11 +186,12 @@ public:
 
 
 TMPL
-QUAL::gmHash(gmuint a_size)
+QUAL::gmHash(gmuint a_size, bool a_grow)
 {
   // make sure size is power of 2
   GM_ASSERT((a_size & (a_size - 1)) == 0);
   m_size = a_size;
+  m_grow = a_grow;
   m_table = new T *[a_size];
   int i = m_size;
   while(i--)
@@ -254,10 +258,39 @@ T * QUAL::Insert(T * a_node)
   a_node->NQUAL::m_next = *node;
   *node = a_node;
   ++m_count;
+  if(m_grow && m_count > m_size) Grow();
   return NULL;
 }
 
 
+TMPL
+void QUAL::Grow()
+{
+  // insert everything again into twice the slots, which keeps each slot in order
+  T ** table = m_table;
+  gmuint size = m_size;
+  m_size = size * 2;
+  m_table = new T *[m_size];
+  gmuint i = m_size;
+  while(i--)
+  {
+    m_table[i] = NULL;
+  }
+  m_count = 0;
+  for(i = 0; i < size; ++i)
+  {
+    T * node = table[i], * next;
+    while(node)
+    {
+      next = node->NQUAL::m_next;
+      Insert(node);
+      node = next;
+    }
+  }
+  delete [] table;
+}
+
+
 TMPL
 T * QUAL::Remove(T * a_node)
 {
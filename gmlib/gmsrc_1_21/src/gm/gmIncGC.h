@@ -182,7 +182,8 @@ public:
   {
     if(m_scan == a_obj)
     {
-      m_scan = a_obj->GetPrev();
+      // m_scan is the first black, the grays before it have not been traced yet
+      m_scan = a_obj->GetNext();
     }
     if(m_free == a_obj)
     {
@@ -0,0 +1,240 @@
+/*
+    _____               __  ___          __            ____        _      __
+   / ___/__ ___ _  ___ /  |/  /__  ___  / /_____ __ __/ __/_______(_)__  / /_
+  / (_ / _ `/  ' \/ -_) /|_/ / _ \/ _ \/  '_/ -_) // /\ \/ __/ __/ / _ \/ __/
+  \___/\_,_/_/_/_/\__/_/  /_/\___/_//_/_/\_\\__/\_, /___/\__/_/ /_/ .__/\__/
+                                               /___/             /_/
+
+  See Copyright Notice in gmMachine.h
+
+*/
+
+#include "gmConfig.h"
+#include "gmLZ.h"
+
+#define GMLZ_HASHBITS       12
+#define GMLZ_HASHSIZE       (1 << GMLZ_HASHBITS)
+#define GMLZ_MAXOFFSET      0xffff
+#define GMLZ_READBUFFERSIZE 4096
+
+
+static inline gmuint32 gmLZHash(const gmuint8 * a_data)
+{
+  gmuint32 value = a_data[0] | (a_data[1] << 8) | (a_data[2] << 16) | (a_data[3] << 24);
+  return (value * 2654435761u) >> (32 - GMLZ_HASHBITS);
+}
+
+
+static unsigned int gmLZWriteLength(gmStream &a_stream, unsigned int a_length)
+{
+  unsigned int written = 0;
+  gmuint8 byte = 255;
+  while(a_length >= 255)
+  {
+    a_stream.Write(&byte, 1);
+    a_length -= 255;
+    ++written;
+  }
+  byte = (gmuint8) a_length;
+  a_stream.Write(&byte, 1);
+  return written + 1;
+}
+
+
+// a_matchLength of 0 writes the final literals only sequence
+static unsigned int gmLZWriteSequence(gmStream &a_stream, const gmuint8 * a_literals, unsigned int a_numLiterals, unsigned int a_offset, unsigned int a_matchLength)
+{
+  unsigned int written = 1;
+  unsigned int matchLength = (a_matchLength) ? a_matchLength - GMLZ_MINMATCH : 0;
+  gmuint8 token = (gmuint8) ((((a_numLiterals < 15) ? a_numLiterals : 15) << 4) | ((matchLength < 15) ? matchLength : 15));
+
+  a_stream.Write(&token, 1);
+  if(a_numLiterals >= 15)
+  {
+    written += gmLZWriteLength(a_stream, a_numLiterals - 15);
+  }
+  a_stream.Write(a_literals, a_numLiterals);
+  written += a_numLiterals;
+
+  if(a_matchLength)
+  {
+    gmuint8 offset[2] = { (gmuint8) (a_offset & 0xff), (gmuint8) (a_offset >> 8) };
+    a_stream.Write(offset, 2);
+    written += 2;
+    if(matchLength >= 15)
+    {
+      written += gmLZWriteLength(a_stream, matchLength - 15);
+    }
+  }
+  return written;
+}
+
+
+unsigned int gmLZCompress(const void * a_data, unsigned int a_size, gmStream &a_stream)
+{
+  const gmuint8 * data = (const gmuint8 *) a_data;
+  const gmuint8 * end = data + a_size;
+  const gmuint8 * anchor = data;
+  const gmuint8 * position = data;
+  unsigned int written = 0;
+
+  // positions + 1 of the last occurence of each hashed 4 byte run, 0 for none
+  gmuint32 * table = new gmuint32[GMLZ_HASHSIZE];
+  memset(table, 0, sizeof(gmuint32) * GMLZ_HASHSIZE);
+
+  while(position + GMLZ_MINMATCH <= end)
+  {
+    gmuint32 hash = gmLZHash(position);
+    gmuint32 candidate = table[hash];
+    table[hash] = (gmuint32) (position - data) + 1;
+
+    if(candidate)
+    {
+      const gmuint8 * match = data + candidate - 1;
+      if((position - match) <= GMLZ_MAXOFFSET && memcmp(match, position, GMLZ_MINMATCH) == 0)
+      {
+        unsigned int length = GMLZ_MINMATCH;
+        while(position + length < end && match[length] == position[length])
+        {
+          ++length;
+        }
+        written += gmLZWriteSequence(a_stream, anchor, (unsigned int) (position - anchor), (unsigned int) (position - match), length);
+
+        // hash the positions within the match so later repeats can find them
+        const gmuint8 * matchEnd = position + length;
+        for(++position; position < matchEnd && position + GMLZ_MINMATCH <= end; ++position)
+        {
+          table[gmLZHash(position)] = (gmuint32) (position - data) + 1;
+        }
+        position = matchEnd;
+        anchor = position;
+        continue;
+      }
+    }
+    ++position;
+  }
+
+  if(anchor < end)
+  {
+    written += gmLZWriteSequence(a_stream, anchor, (unsigned int) (end - anchor), 0, 0);
+  }
+
+  delete[] table;
+  return written;
+}
+
+
+/// \class gmLZReader
+/// \brief gmLZReader reads compressed data in place from memory backed streams, otherwise through a small buffer.
+class gmLZReader
+{
+public:
+
+  gmLZReader(gmStream &a_stream, unsigned int a_size) : m_stream(a_stream)
+  {
+    m_pos = (const gmuint8 *) a_stream.ReadDirect(a_size);
+    if(m_pos)
+    {
+      m_end = m_pos + a_size;
+      m_remaining = 0;
+    }
+    else
+    {
+      m_pos = m_end = m_buffer;
+      m_remaining = a_size;
+    }
+  }
+
+  inline bool GetByte(gmuint8 &a_byte)
+  {
+    if(m_pos == m_end && !Fill()) { return false; }
+    a_byte = *(m_pos++);
+    return true;
+  }
+
+  bool Read(gmuint8 * a_dest, unsigned int a_size)
+  {
+    unsigned int buffered = (unsigned int) (m_end - m_pos);
+    if(a_size <= buffered)
+    {
+      memcpy(a_dest, m_pos, a_size);
+      m_pos += a_size;
+      return true;
+    }
+
+    // take what is buffered, and read the rest straight into the destination
+    memcpy(a_dest, m_pos, buffered);
+    m_pos = m_end;
+    a_size -= buffered;
+    if(a_size > m_remaining) { return false; }
+    m_remaining -= a_size;
+    return m_stream.Read(a_dest + buffered, a_size) == a_size;
+  }
+
+private:
+
+  bool Fill()
+  {
+    unsigned int size = (m_remaining < GMLZ_READBUFFERSIZE) ? m_remaining : GMLZ_READBUFFERSIZE;
+    if(size == 0 || m_stream.Read(m_buffer, size) != size) { return false; }
+    m_remaining -= size;
+    m_pos = m_buffer;
+    m_end = m_buffer + size;
+    return true;
+  }
+
+  gmStream &m_stream;
+  const gmuint8 * m_pos;
+  const gmuint8 * m_end;
+  unsigned int m_remaining;
+  gmuint8 m_buffer[GMLZ_READBUFFERSIZE];
+};
+
+
+static bool gmLZReadLength(gmLZReader &a_reader, unsigned int &a_length)
+{
+  gmuint8 byte;
+  do
+  {
+    if(!a_reader.GetByte(byte)) { return false; }
+    a_length += byte;
+  } while(byte == 255);
+  return true;
+}
+
+
+bool gmLZDecompress(gmStream &a_stream, unsigned int a_compressedSize, void * a_dest, unsigned int a_size)
+{
+  gmLZReader reader(a_stream, a_compressedSize);
+  gmuint8 * start = (gmuint8 *) a_dest;
+  gmuint8 * dest = start;
+  gmuint8 * end = start + a_size;
+  gmuint8 token, offset[2];
+
+  while(dest < end)
+  {
+    if(!reader.GetByte(token)) { return false; }
+
+    // literals
+    unsigned int length = token >> 4;
+    if(length == 15 && !gmLZReadLength(reader, length)) { return false; }
+    if(length > (unsigned int) (end - dest) || !reader.Read(dest, length)) { return false; }
+    dest += length;
+    if(dest == end) { break; }
+
+    // match, copied a byte at a time as it may overlap itself
+    if(!reader.GetByte(offset[0]) || !reader.GetByte(offset[1])) { return false; }
+    unsigned int distance = offset[0] | (offset[1] << 8);
+    if(distance == 0 || distance > (unsigned int) (dest - start)) { return false; }
+    length = token & 15;
+    if(length == 15 && !gmLZReadLength(reader, length)) { return false; }
+    length += GMLZ_MINMATCH;
+    if(length > (unsigned int) (end - dest)) { return false; }
+    const gmuint8 * match = dest - distance;
+    while(length--)
+    {
+      *(dest++) = *(match++);
+    }
+  }
+  return true;
+}
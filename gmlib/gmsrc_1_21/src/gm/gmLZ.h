@@ -0,0 +1,43 @@
+/*
+    _____               __  ___          __            ____        _      __
+   / ___/__ ___ _  ___ /  |/  /__  ___  / /_____ __ __/ __/_______(_)__  / /_
+  / (_ / _ `/  ' \/ -_) /|_/ / _ \/ _ \/  '_/ -_) // /\ \/ __/ __/ / _ \/ __/
+  \___/\_,_/_/_/_/\__/_/  /_/\___/_//_/_/\_\\__/\_, /___/\__/_/ /_/ .__/\__/
+                                               /___/             /_/
+
+  See Copyright Notice in gmMachine.h
+
+*/
+
+#ifndef _GMLZ_H_
+#define _GMLZ_H_
+
+#include "gmConfig.h"
+#include "gmStream.h"
+
+/*
+  gmLZ is a small byte oriented LZ77 compressor used for the source code section of gm libs.
+
+  The compressed data is a list of sequences, each of
+
+  token                       [1 byte ] // high nibble literal count, low nibble match length - GMLZ_MINMATCH
+  literal_count_ext           [1 byte ] * n // present if the nibble is 15, bytes are added until one is not 255
+  literals                    [1 byte ] * literal count
+  match_offset                [2 bytes] // little endian, distance back from the current output position
+  match_length_ext            [1 byte ] * n // as literal_count_ext
+
+  The last sequence ends after its literals, once the decompressed size is reached.
+*/
+
+#define GMLZ_MINMATCH 4
+
+/// \brief gmLZCompress() will compress a_size bytes from a_data and write them to a_stream.
+/// \return the number of bytes written.
+unsigned int gmLZCompress(const void * a_data, unsigned int a_size, gmStream &a_stream);
+
+/// \brief gmLZDecompress() will read a_compressedSize bytes from a_stream and decompress them into a_dest.
+/// \param a_size is the decompressed size, a_dest must hold this many bytes.
+/// \return false if the compressed data is corrupt.
+bool gmLZDecompress(gmStream &a_stream, unsigned int a_compressedSize, void * a_dest, unsigned int a_size);
+
+#endif // _GMLZ_H_
@@ -0,0 +1,539 @@
+/*
+    _____               __  ___          __            ____        _      __
+   / ___/__ ___ _  ___ /  |/  /__  ___  / /_____ __ __/ __/_______(_)__  / /_
+  / (_ / _ `/  ' \/ -_) /|_/ / _ \/ _ \/  '_/ -_) // /\ \/ __/ __/ / _ \/ __/
+  \___/\_,_/_/_/_/\__/_/  /_/\___/_//_/_/\_\\__/\_, /___/\__/_/ /_/ .__/\__/
+                                               /___/             /_/
+
+  See Copyright Notice in gmMachine.h
+
+*/
+
+#include "gmConfig.h"
+#include "gmLibBundle.h"
+#include "gmLibHooks.h"
+#include "gmMachine.h"
+
+#include <ctype.h>
+
+#define GMLIBBUNDLE_HEADERSIZE (sizeof(gmuint32) * 5)
+#define GMLIBBUNDLE_ENTRYSIZE  (sizeof(gmuint32) * 6)
+
+
+static inline gmuint32 gmLibBundleSwap(gmuint32 a_x)
+{
+    return (a_x << 24) | ((a_x << 8) & 0x00ff0000) | ((a_x >> 8) & 0x0000ff00) | ((a_x >> 24) & 0x000000ff);
+}
+
+
+//
+// gmStreamRange
+//
+
+
+gmStreamRange::gmStreamRange()
+{
+    m_stream = NULL;
+    m_data = NULL;
+    m_offset = 0;
+    m_size = 0;
+    m_cursor = 0;
+}
+
+
+gmStreamRange::~gmStreamRange()
+{
+}
+
+
+unsigned int gmStreamRange::Seek(unsigned int p_pos)
+{
+    unsigned int oldCursor = m_cursor;
+    if (p_pos > m_size) return ILLEGAL_POS;
+    m_cursor = p_pos;
+    return oldCursor;
+}
+
+
+unsigned int gmStreamRange::Tell() const
+{
+    return m_cursor;
+}
+
+
+unsigned int gmStreamRange::GetSize() const
+{
+    return m_size;
+}
+
+
+unsigned int gmStreamRange::Read(void* p_buffer, unsigned int p_n, bool p_swap)
+{
+    unsigned int remain = m_size - m_cursor;
+    if (p_n > remain)
+    {
+        m_flags |= F_EOS;
+        p_n = remain;
+    }
+
+    const void* source = p_buffer;
+
+    if (m_data)
+    {
+        source = m_data + m_cursor;
+    }
+    else if (m_stream->Seek(m_offset + m_cursor) == (unsigned int)ILLEGAL_POS
+        || (p_n = m_stream->Read(p_buffer, p_n)) == 0)
+    {
+        return 0;
+    }
+
+    // swap hack
+    if (p_swap && GetSwapEndianOnWrite())
+    {
+        unsigned int words = p_n / sizeof(gmuint32);
+        SwapEndian32(p_buffer, source, words);
+        if (source != p_buffer)
+        {
+            memcpy((char*)p_buffer + words * sizeof(gmuint32), (const char*)source + words * sizeof(gmuint32), p_n - words * sizeof(gmuint32));
+        }
+    }
+    else if (source != p_buffer)
+    {
+        memcpy(p_buffer, source, p_n);
+    }
+
+    m_cursor += p_n;
+    return p_n;
+}
+
+
+unsigned int gmStreamRange::Write(const void* p_buffer, unsigned int p_n, bool p_swap)
+{
+    m_flags |= F_ERROR;
+    return 0;
+}
+
+
+const void* gmStreamRange::ReadDirect(unsigned int p_n)
+{
+    const void* data;
+
+    if (p_n > m_size - m_cursor)
+    {
+        return NULL;
+    }
+
+    if (m_data)
+    {
+        data = m_data + m_cursor;
+    }
+    else if (m_stream->Seek(m_offset + m_cursor) == (unsigned int)ILLEGAL_POS
+        || (data = m_stream->ReadDirect(p_n)) == NULL)
+    {
+        return NULL;
+    }
+
+    m_cursor += p_n;
+    return data;
+}
+
+
+void gmStreamRange::Open(gmStream* a_stream, unsigned int a_offset, unsigned int a_size)
+{
+    m_stream = a_stream;
+    m_data = NULL;
+    m_offset = a_offset;
+    m_size = a_size;
+    m_cursor = 0;
+    m_flags = F_READ | F_SIZE | F_SEEK | F_TELL;
+}
+
+
+void gmStreamRange::Open(const void* a_buffer, unsigned int a_size)
+{
+    m_stream = NULL;
+    m_data = (const char*)a_buffer;
+    m_offset = 0;
+    m_size = a_size;
+    m_cursor = 0;
+    m_flags = F_READ | F_SIZE | F_SEEK | F_TELL;
+}
+
+
+//
+// gmLibBundle
+//
+
+
+gmLibBundle::gmLibBundle()
+{
+    m_stream = NULL;
+    m_data = NULL;
+    m_numEntries = 0;
+    m_hashSize = 0;
+    m_namesSize = 0;
+    m_slots = NULL;
+    m_entries = NULL;
+    m_names = NULL;
+}
+
+
+gmLibBundle::~gmLibBundle()
+{
+    Close();
+}
+
+
+bool gmLibBundle::Open(gmStream& a_stream)
+{
+    gmuint32 header[5];
+    bool swap = false;
+    unsigned int size, indexSize, i;
+
+    Close();
+
+    a_stream.Seek(0);
+    if (a_stream.Read(header, sizeof(header)) != sizeof(header))
+    {
+        return false;
+    }
+
+    if (header[0] != 'gmb0')
+    {
+        if (header[0] != gmLibBundleSwap('gmb0'))
+        {
+            return false;
+        }
+        swap = true;
+        for (i = 0; i < 5; i++)
+        {
+            header[i] = gmLibBundleSwap(header[i]);
+        }
+    }
+
+    m_numEntries = header[2];
+    m_hashSize = header[3];
+    m_namesSize = header[4];
+    size = a_stream.GetSize();
+
+    // the index must fit in the stream, and the slot count must be a power of 2
+    indexSize = m_hashSize * sizeof(gmuint32) + m_numEntries * GMLIBBUNDLE_ENTRYSIZE;
+    if (m_hashSize == 0 || (m_hashSize & (m_hashSize - 1)) || m_hashSize > (size >> 2)
+        || m_numEntries > (size / GMLIBBUNDLE_ENTRYSIZE) || m_namesSize == 0
+        || (unsigned long long)GMLIBBUNDLE_HEADERSIZE + indexSize + m_namesSize > size)
+    {
+        m_numEntries = 0;
+        return false;
+    }
+
+    m_slots = new gmuint32[m_hashSize];
+    m_entries = new Entry[m_numEntries];
+    m_names = new char[m_namesSize];
+
+    if (a_stream.Read(m_slots, m_hashSize * sizeof(gmuint32)) != m_hashSize * sizeof(gmuint32)
+        || a_stream.Read(m_entries, m_numEntries * GMLIBBUNDLE_ENTRYSIZE) != m_numEntries * GMLIBBUNDLE_ENTRYSIZE
+        || a_stream.Read(m_names, m_namesSize) != m_namesSize
+        || m_names[m_namesSize - 1] != '\0')
+    {
+        Close();
+        return false;
+    }
+
+    if (swap)
+    {
+        gmStream::SwapEndian32(m_slots, m_slots, m_hashSize);
+        gmStream::SwapEndian32(m_entries, m_entries, m_numEntries * (GMLIBBUNDLE_ENTRYSIZE / sizeof(gmuint32)));
+    }
+
+    for (i = 0; i < m_hashSize; i++)
+    {
+        if (m_slots[i] > m_numEntries)
+        {
+            Close();
+            return false;
+        }
+    }
+
+    for (i = 0; i < m_numEntries; i++)
+    {
+        const Entry& entry = m_entries[i];
+        if (entry.m_nameOffset >= m_namesSize || entry.m_next > m_numEntries
+            || entry.m_offset > size || entry.m_size > size - entry.m_offset)
+        {
+            Close();
+            return false;
+        }
+    }
+
+    // memory backed bundles hand out entries in place
+    a_stream.Seek(0);
+    m_data = (const char*)a_stream.ReadDirect(size);
+    m_stream = &a_stream;
+    return true;
+}
+
+
+void gmLibBundle::Close()
+{
+    if (m_slots) delete[] m_slots;
+    if (m_entries) delete[] m_entries;
+    if (m_names) delete[] m_names;
+
+    m_stream = NULL;
+    m_data = NULL;
+    m_numEntries = 0;
+    m_hashSize = 0;
+    m_namesSize = 0;
+    m_slots = NULL;
+    m_entries = NULL;
+    m_names = NULL;
+}
+
+
+int gmLibBundle::Find(const char* a_name) const
+{
+    if (m_numEntries == 0)
+    {
+        return -1;
+    }
+
+    gmuint32 hash = Hash(a_name);
+    gmuint32 index = m_slots[hash & (m_hashSize - 1)];
+
+    // chains are bounded by the entry count so a corrupt index can not loop
+    for (gmuint32 steps = 0; index && steps < m_numEntries; steps++)
+    {
+        const Entry& entry = m_entries[index - 1];
+        if (entry.m_hash == hash && Match(m_names + entry.m_nameOffset, a_name))
+        {
+            return (int)index - 1;
+        }
+        index = entry.m_next;
+    }
+
+    return -1;
+}
+
+
+const char* gmLibBundle::GetName(int a_index) const
+{
+    GM_ASSERT(a_index >= 0 && (gmuint32)a_index < m_numEntries);
+    return m_names + m_entries[a_index].m_nameOffset;
+}
+
+
+unsigned int gmLibBundle::GetFlags(int a_index) const
+{
+    GM_ASSERT(a_index >= 0 && (gmuint32)a_index < m_numEntries);
+    return m_entries[a_index].m_flags;
+}
+
+
+bool gmLibBundle::OpenEntry(int a_index, gmStreamRange& a_stream) const
+{
+    if (a_index < 0 || (gmuint32)a_index >= m_numEntries)
+    {
+        return false;
+    }
+
+    const Entry& entry = m_entries[a_index];
+
+    if (m_data)
+    {
+        a_stream.Open(m_data + entry.m_offset, entry.m_size);
+    }
+    else
+    {
+        a_stream.Open(m_stream, entry.m_offset, entry.m_size);
+    }
+
+    bool bigEndian = (entry.m_flags & GMLIBBUNDLE_BIGENDIAN) != 0;
+    a_stream.SetEndianOnWrite(bigEndian ? GM_ENDIAN_BIG : GM_ENDIAN_LITTLE);
+    return true;
+}
+
+
+gmFunctionObject* gmLibBundle::BindLib(gmMachine& a_machine, const char* a_name, bool a_lazy) const
+{
+    gmStreamRange stream;
+
+    int index = Find(a_name);
+    if (index < 0 || !OpenEntry(index, stream))
+    {
+        a_machine.GetLog().LogEntry("lib %s not found in bundle", a_name);
+        return NULL;
+    }
+
+    return gmLibHooks::BindLib(a_machine, stream, GetName(index), a_lazy);
+}
+
+
+static inline char gmLibBundleNameChar(char a_c)
+{
+    return (a_c == '\\') ? '/' : (char)tolower((gmuint8)a_c);
+}
+
+
+gmuint32 gmLibBundle::Hash(const char* a_name)
+{
+    // FNV-1a over the lower case name
+    gmuint32 hash = 2166136261u;
+    for (; *a_name; a_name++)
+    {
+        hash = (hash ^ (gmuint8)gmLibBundleNameChar(*a_name)) * 16777619u;
+    }
+    return hash;
+}
+
+
+bool gmLibBundle::Match(const char* a_nameA, const char* a_nameB)
+{
+    for (;;)
+    {
+        char a = gmLibBundleNameChar(*(a_nameA++));
+        if (a != gmLibBundleNameChar(*(a_nameB++))) return false;
+        if (a == '\0') return true;
+    }
+}
+
+
+//
+// gmLibBundleWriter
+//
+
+
+gmLibBundleWriter::gmLibBundleWriter()
+{
+}
+
+
+gmLibBundleWriter::~gmLibBundleWriter()
+{
+}
+
+
+bool gmLibBundleWriter::Add(const char* a_name, const void* a_lib, unsigned int a_size)
+{
+    Entry entry;
+    gmuint32 header[2];
+    bool swapped;
+    unsigned int i;
+
+    if (a_size < sizeof(header))
+    {
+        return false;
+    }
+
+    memcpy(header, a_lib, sizeof(header));
+    if (header[0] == 'gml0')
+    {
+        swapped = false;
+    }
+    else if (header[0] == gmLibBundleSwap('gml0'))
+    {
+        swapped = true;
+        header[1] = gmLibBundleSwap(header[1]);
+    }
+    else
+    {
+        return false;
+    }
+
+    entry.m_hash = gmLibBundle::Hash(a_name);
+    for (i = 0; i < m_entries.Count(); i++)
+    {
+        if (m_entries[i].m_hash == entry.m_hash && gmLibBundle::Match(m_names.GetData() + m_entries[i].m_nameOffset, a_name))
+        {
+            return false;
+        }
+    }
+
+    entry.m_flags = 0;
+    if (gmIsLittleEndian() ? swapped : !swapped)
+    {
+        entry.m_flags |= GMLIBBUNDLE_BIGENDIAN;
+    }
+    if (header[1] & 1)
+    {
+        entry.m_flags |= GMLIBBUNDLE_DEBUG;
+    }
+
+    entry.m_nameOffset = m_names.GetSize();
+    m_names.Write(a_name, strlen(a_name) + 1);
+
+    // keep each lib 4 byte aligned so line info can be used in place
+    static const char pad[4] = { 0, 0, 0, 0 };
+    m_libs.Write(pad, (4 - (m_libs.GetSize() & 3)) & 3);
+    entry.m_offset = m_libs.GetSize();
+    entry.m_size = a_size;
+    m_libs.Write(a_lib, a_size);
+
+    m_entries.InsertLast(entry);
+    return true;
+}
+
+
+bool gmLibBundleWriter::Write(gmStream& a_stream)
+{
+    static const char pad[4] = { 0, 0, 0, 0 };
+    gmuint32 numEntries = m_entries.Count();
+    gmuint32 hashSize = 2, namesSize, libsOffset, i;
+    gmuint32* slots;
+    gmuint32* next;
+
+    while (hashSize < numEntries * 2)
+    {
+        hashSize <<= 1;
+    }
+
+    // names are 0 terminated, so an empty bundle still has one
+    if (m_names.GetSize() == 0)
+    {
+        m_names.Write(pad, 1);
+    }
+    namesSize = m_names.GetSize();
+
+    libsOffset = GMLIBBUNDLE_HEADERSIZE + hashSize * sizeof(gmuint32) + numEntries * GMLIBBUNDLE_ENTRYSIZE + namesSize;
+    libsOffset = (libsOffset + 3) & ~3;
+
+    // chain the entries, keeping each chain in the order entries were added
+    slots = new gmuint32[hashSize];
+    next = new gmuint32[numEntries + 1];
+    memset(slots, 0, sizeof(gmuint32) * hashSize);
+    for (i = numEntries; i > 0; i--)
+    {
+        gmuint32 slot = m_entries[i - 1].m_hash & (hashSize - 1);
+        next[i] = slots[slot];
+        slots[slot] = i;
+    }
+
+    a_stream << (gmuint32)'gmb0';
+    a_stream << (gmuint32)0;
+    a_stream << numEntries;
+    a_stream << hashSize;
+    a_stream << namesSize;
+
+    for (i = 0; i < hashSize; i++)
+    {
+        a_stream << slots[i];
+    }
+
+    for (i = 0; i < numEntries; i++)
+    {
+        const Entry& entry = m_entries[i];
+        a_stream << entry.m_hash;
+        a_stream << entry.m_nameOffset;
+        a_stream << (gmuint32)(libsOffset + entry.m_offset);
+        a_stream << entry.m_size;
+        a_stream << entry.m_flags;
+        a_stream << next[i + 1];
+    }
+
+    delete[] slots;
+    delete[] next;
+
+    a_stream.Write(m_names.GetData(), namesSize);
+    a_stream.Write(pad, libsOffset - (GMLIBBUNDLE_HEADERSIZE + hashSize * sizeof(gmuint32) + numEntries * GMLIBBUNDLE_ENTRYSIZE + namesSize));
+    return a_stream.Write(m_libs.GetData(), m_libs.GetSize()) == m_libs.GetSize();
+}
@@ -0,0 +1,176 @@
+/*
+    _____               __  ___          __            ____        _      __
+   / ___/__ ___ _  ___ /  |/  /__  ___  / /_____ __ __/ __/_______(_)__  / /_
+  / (_ / _ `/  ' \/ -_) /|_/ / _ \/ _ \/  '_/ -_) // /\ \/ __/ __/ / _ \/ __/
+  \___/\_,_/_/_/_/\__/_/  /_/\___/_//_/_/\_\\__/\_, /___/\__/_/ /_/ .__/\__/
+                                               /___/             /_/
+
+  See Copyright Notice in gmMachine.h
+
+*/
+
+#ifndef _GMLIBBUNDLE_H_
+#define _GMLIBBUNDLE_H_
+
+#include "gmConfig.h"
+#include "gmArraySimple.h"
+#include "gmStreamBuffer.h"
+
+class gmMachine;
+class gmFunctionObject;
+
+#define GMLIBBUNDLE_BIGENDIAN 0x01 // entry flag, the lib is big endian
+#define GMLIBBUNDLE_DEBUG     0x02 // entry flag, the lib has debug info
+
+/// \class gmStreamRange
+/// \brief gmStreamRange is a read only stream over part of another stream, or over a block of memory.
+///        Ranges over a stream share its cursor, so only one may be read at a time.
+class gmStreamRange : public gmStream
+{
+public:
+
+    gmStreamRange();
+    virtual ~gmStreamRange();
+
+    virtual unsigned int Seek(unsigned int p_pos);
+    virtual unsigned int Tell() const;
+    virtual unsigned int GetSize() const;
+    virtual unsigned int Read(void* p_buffer, unsigned int p_n, bool p_swap = false);
+    virtual unsigned int Write(const void* p_buffer, unsigned int p_n, bool p_swap = false);
+    virtual const void* ReadDirect(unsigned int p_n);
+
+    void Open(gmStream* a_stream, unsigned int a_offset, unsigned int a_size);
+    void Open(const void* a_buffer, unsigned int a_size);
+
+private:
+
+    gmStream* m_stream;
+    const char* m_data;
+    unsigned int m_offset;
+    unsigned int m_size;
+    unsigned int m_cursor;
+};
+
+/// \class gmLibBundle
+/// \brief gmLibBundle reads a bundle of gm libs, see gmLibBundleWriter for the format.  Entries are found by name
+///        through the bundle's hash index, and bound straight from the bundle stream.
+class gmLibBundle
+{
+public:
+
+    gmLibBundle();
+    ~gmLibBundle();
+
+    /// \brief Open() will read the bundle index.  a_stream must stay open until Close().
+    /// \return false if a_stream is not a valid bundle.
+    bool Open(gmStream& a_stream);
+
+    /// \brief Close() will free the index.
+    void Close();
+
+    inline int GetNumEntries() const { return m_numEntries; }
+
+    /// \brief Find() will return the index of the named entry, or -1.  Names are not case sensitive and treat
+    ///        '\\' as '/'.
+    int Find(const char* a_name) const;
+
+    const char* GetName(int a_index) const;
+    unsigned int GetFlags(int a_index) const;
+
+    /// \brief OpenEntry() will open a_stream over the lib of an entry, with its swap endian flag set.  Entries of
+    ///        memory backed bundles are read in place, and can be read from several threads at once.
+    bool OpenEntry(int a_index, gmStreamRange& a_stream) const;
+
+    /// \brief BindLib() will bind the named lib to the machine, see gmLibHooks::BindLib().
+    /// \return the root function, or NULL if the lib was not found or could not be bound.
+    gmFunctionObject* BindLib(gmMachine& a_machine, const char* a_name, bool a_lazy = false) const;
+
+    /// \brief Hash() is the name hash used by the index.
+    static gmuint32 Hash(const char* a_name);
+
+    /// \brief Match() will compare two names the way Find() does.
+    static bool Match(const char* a_nameA, const char* a_nameB);
+
+private:
+
+    struct Entry
+    {
+        gmuint32 m_hash;
+        gmuint32 m_nameOffset;
+        gmuint32 m_offset;
+        gmuint32 m_size;
+        gmuint32 m_flags;
+        gmuint32 m_next; //!< index + 1 of the next entry in the same slot, 0 for none
+    };
+
+    gmStream* m_stream;
+    const char* m_data; //!< the whole bundle when memory backed
+    gmuint32 m_numEntries;
+    gmuint32 m_hashSize;
+    gmuint32 m_namesSize;
+    gmuint32* m_slots; //!< index + 1 of the first entry in each slot, 0 for none
+    Entry* m_entries;
+    char* m_names;
+};
+
+/// \class gmLibBundleWriter
+/// \brief gmLibBundleWriter collects gm libs and writes them as a bundle.
+class gmLibBundleWriter
+{
+public:
+
+    gmLibBundleWriter();
+    ~gmLibBundleWriter();
+
+    /// \brief Add() will copy a lib into the bundle.
+    /// \return false if a_lib is not a gm lib or a_name is already used.
+    bool Add(const char* a_name, const void* a_lib, unsigned int a_size);
+
+    /// \brief Write() will write the bundle, the index is written in the endian of a_stream.
+    bool Write(gmStream& a_stream);
+
+private:
+
+    struct Entry
+    {
+        gmuint32 m_hash;
+        gmuint32 m_nameOffset;
+        gmuint32 m_offset; //!< relative to the start of the lib data
+        gmuint32 m_size;
+        gmuint32 m_flags;
+    };
+
+    gmArraySimple<Entry> m_entries;
+    gmStreamBufferDynamic m_names;
+    gmStreamBufferDynamic m_libs;
+};
+
+/*
+
+  Bundle file format for .gmb files (gm lib bundles) (endian of the index given by the id)
+
+  'gmb0'                      [4 bytes]
+  flags                       [4 bytes]  // reserved, 0
+  num_entries                 [4 bytes]
+  hash_size                   [4 bytes]  // number of slots, a power of 2
+  names_size                  [4 bytes]
+
+  slots[hash_size]            [4 bytes]  // entry index + 1 of the first entry in the slot, 0 for none
+
+  entries[num_entries]
+  {
+    name_hash                 [4 bytes]  // gmLibBundle::Hash() of the name, slot is name_hash & (hash_size - 1)
+    name_offset               [4 bytes]  // into names
+    offset                    [4 bytes]  // of the lib, relative to start of bundle, 4 byte aligned
+    size                      [4 bytes]
+    flags                     [4 bytes]  // 0x01 - big endian lib, 0x02 - debug lib
+    next                      [4 bytes]  // entry index + 1 of the next entry in the same slot, 0 for none
+  }
+
+  names                       [1 byte ] * names_size of 0 terminated strings
+
+  libs                        // each a complete gm lib, see gmLibHooks.h
+
+*/
+
+#endif // _GMLIBBUNDLE_H_
@@ -14,13 +14,18 @@
 #include "gmMachine.h"
 #include "gmFunctionObject.h"
 #include "gmStringObject.h"
+#include "gmLZ.h"
 
+#define GMLIB_SOURCE_LZ 0x01
 
-gmLibHooks::gmLibHooks(gmStream &a_stream, const char * a_source) :
+
+gmLibHooks::gmLibHooks(gmStream &a_stream, const char * a_source, bool a_compressSource) :
+  m_symbolHash(GMLIBHOOKS_SYMBOLHASHSIZE, true),
   m_allocator(1, GMCODETREE_CHAINSIZE)
 {
   m_stream = &a_stream;
   m_source = a_source;
+  m_compressSource = a_compressSource;
 }
 
 
@@ -43,41 +48,39 @@ bool gmLibHooks::AddFunction(gmFunctionInfo &a_info)
 {
     m_functionStream.SetSwapEndianOnWrite(SwapEndian());
 
-  // write the function into the stream
-  m_functionStream << (gmuint32) 'func';
-  m_functionStream << (gmuint32) a_info.m_id;
-  m_functionStream << (gmuint32) ((a_info.m_root) ? 1 : 0);
-  m_functionStream << (gmuint32) a_info.m_numParams;
-  m_functionStream << (gmuint32) a_info.m_numLocals;
-  m_functionStream << (gmuint32) a_info.m_maxStackSize;
-  m_functionStream << (gmuint32) a_info.m_byteCodeLength;
+  // write the function into the stream, words are gathered and swapped in bulk
+  gmuint32 words[64];
+  words[0] = 'func';
+  words[1] = a_info.m_id;
+  words[2] = (a_info.m_root) ? 1 : 0;
+  words[3] = a_info.m_numParams;
+  words[4] = a_info.m_numLocals;
+  words[5] = a_info.m_maxStackSize;
+  words[6] = a_info.m_byteCodeLength;
+  m_functionStream.Write(words, sizeof(gmuint32) * 7, true);
   m_functionStream.Write(a_info.m_byteCode, a_info.m_byteCodeLength);
 
   if(m_debug)
   {
-    int numSymbols = a_info.m_numLocals + a_info.m_numParams, i;
-
-    // debug name
-    m_functionStream << (gmuint32) GetSymbolId(a_info.m_debugName);
+    int numSymbols = a_info.m_numLocals + a_info.m_numParams, i, numWords;
 
-    // line info
-    m_functionStream << (gmuint32) a_info.m_lineInfoCount;
-    for(i = 0; i < a_info.m_lineInfoCount; ++i)
+    // debug name and line info, gmLineInfo is laid out as the lib's address, line number pairs
+    words[0] = GetSymbolId(a_info.m_debugName);
+    words[1] = a_info.m_lineInfoCount;
+    m_functionStream.Write(words, sizeof(gmuint32) * 2, true);
+    if(a_info.m_lineInfoCount)
     {
-      m_functionStream << (gmuint32) a_info.m_lineInfo[i].m_address;
-      m_functionStream << (gmuint32) a_info.m_lineInfo[i].m_lineNumber;
+      m_functionStream.Write(a_info.m_lineInfo, sizeof(gmLineInfo) * a_info.m_lineInfoCount, true);
     }
 
     // symbol info
-    for(i = 0; i < numSymbols; ++i)
+    for(i = 0, numWords = 0; i < numSymbols; ++i)
     {
-      if(a_info.m_symbols)
+      words[numWords++] = (a_info.m_symbols) ? GetSymbolId(a_info.m_symbols[i]) : (gmuint32) (~0);
+      if(numWords == 64 || i == numSymbols - 1)
       {
-        m_functionStream << (gmuint32) GetSymbolId(a_info.m_symbols[i]);
-      }
-      else
-      {
-        m_functionStream << (gmuint32) (~0);
+        m_functionStream.Write(words, sizeof(gmuint32) * numWords, true);
+        numWords = 0;
       }
     }
   }
@@ -118,8 +121,24 @@ bool gmLibHooks::End(int a_errors)
       t = strlen(m_source) + 1;
       m_stream->Write(&t, sizeof(gmuint32), true);
       t1 = 0;
-      m_stream->Write(&t1, sizeof(gmuint32), true);
-      m_stream->Write(m_source, t);
+      if(m_compressSource)
+      {
+        // keep the compressed source only if it is smaller
+        gmStreamBufferDynamic compressed;
+        gmuint32 compressedSize = gmLZCompress(m_source, t, compressed);
+        if(compressedSize + sizeof(gmuint32) < t)
+        {
+          t1 = GMLIB_SOURCE_LZ;
+          m_stream->Write(&t1, sizeof(gmuint32), true);
+          m_stream->Write(&compressedSize, sizeof(gmuint32), true);
+          m_stream->Write(compressed.GetData(), compressedSize);
+        }
+      }
+      if(t1 == 0)
+      {
+        m_stream->Write(&t1, sizeof(gmuint32), true);
+        m_stream->Write(m_source, t);
+      }
     }
     else
     {
@@ -154,14 +173,10 @@ gmptr gmLibHooks::GetSymbolId(const char * a_symbol)
   if(a_symbol == NULL) a_symbol = "";
 
   // see if we already have sybmol
-  USymbol * symbol = m_symbols.GetFirst();
-  while(m_symbols.IsValid(symbol))
+  USymbol * symbol = m_symbolHash.Find(a_symbol);
+  if(symbol)
   {
-    if(strcmp(symbol->m_string, a_symbol) == 0)
-    {
-      return symbol->m_offset;
-    }
-    symbol = m_symbols.GetNext(symbol);
+    return symbol->m_offset;
   }
 
   // add a new symbol
@@ -172,6 +187,7 @@ gmptr gmLibHooks::GetSymbolId(const char * a_symbol)
   symbol->m_offset = m_symbolOffset;
   m_symbolOffset += len;
   m_symbols.InsertFirst(symbol);
+  m_symbolHash.Insert(symbol);
   return symbol->m_offset;
 }
 
@@ -226,23 +242,90 @@ struct gmlFunction
 };
 
 
-gmFunctionObject * gmLibHooks::BindLib(gmMachine &a_machine, gmStream &a_stream, const char * a_filename)
+static inline gmuint32 gmLibRead32(const char * a_data, bool a_swap)
+{
+  gmuint32 value;
+  memcpy(&value, a_data, sizeof(value));
+  if(a_swap)
+  {
+    value = (value << 24) | ((value << 8) & 0x00ff0000) | ((value >> 8) & 0x0000ff00) | ((value >> 24) & 0x000000ff);
+  }
+  return value;
+}
+
+
+// reads the source_code block at the cursor. a_source points into memory backed streams, otherwise
+// the source is read or decompressed into a_copy, which the caller must delete.
+static bool gmLibReadSource(gmStream &a_stream, const char * &a_source, char * &a_copy)
+{
+  gmlSource source;
+
+  a_source = NULL;
+  a_copy = NULL;
+  if(a_stream.Read(&source, sizeof(source), true) != sizeof(source) || source.m_size == 0) { return false; }
+  if(source.m_flags & GMLIB_SOURCE_LZ)
+  {
+    // decompressed straight from the stream into the source buffer
+    gmuint32 compressedSize;
+    if(a_stream.Read(&compressedSize, sizeof(compressedSize), true) != sizeof(compressedSize)) { return false; }
+    a_copy = new char[source.m_size];
+    if(!gmLZDecompress(a_stream, compressedSize, a_copy, source.m_size)) { return false; }
+    a_source = a_copy;
+  }
+  else
+  {
+    a_source = (const char *) a_stream.ReadDirect(source.m_size);
+    if(a_source == NULL)
+    {
+      a_copy = new char[source.m_size];
+      if(a_stream.Read(a_copy, source.m_size) != source.m_size) { return false; }
+      a_source = a_copy;
+    }
+  }
+  return (a_source[source.m_size - 1] == '\0');
+}
+
+
+bool gmLibHooks::ReadSource(gmStream &a_stream, const char * &a_source, char * &a_copy)
+{
+  gmlHeader header;
+
+  a_source = NULL;
+  a_copy = NULL;
+  a_stream.Seek(0);
+  if((a_stream.Read(&header, sizeof(header), true) != sizeof(header)) || header.m_id != 'gml0') { return false; }
+  if(header.m_scOffset == 0) { return true; }
+  a_stream.Seek(header.m_scOffset);
+  if(!gmLibReadSource(a_stream, a_source, a_copy))
+  {
+    if(a_copy)
+    {
+      delete[] a_copy;
+      a_copy = NULL;
+    }
+    a_source = NULL;
+    return false;
+  }
+  return true;
+}
+
+
+gmFunctionObject * gmLibHooks::BindLib(gmMachine &a_machine, gmStream &a_stream, const char * a_filename, bool a_lazy)
 {
   gmlHeader header;
   gmlStrings strings;
-  gmlSource source;
-  gmlFunction function;
+  gmLibImage image, * lib = &image;
+  gmStreamBufferStatic libStream;
+  gmStream * stream = &a_stream;
   gmFunctionObject * functionObject = NULL;
-  gmFunctionObject ** functionObjects = NULL;
-  bool error = true, debug = false;
-  char * stringTable = NULL;
+  bool error = true;
+  char * stringTableCopy = NULL;
   char * sourceCode = NULL;
-  char * byteCode = NULL;
-  unsigned int i, j;
+  unsigned int i;
   gmuint32 numFunctions = 0;
-  gmuint32 sourceCodeId = 0;
-  gmuint32 scratchSize = 2048;
-  gmuint8 * scratch = new gmuint8[scratchSize];
+  gmuint32 functionsOffset;
+
+  memset(&image, 0, sizeof(image));
 
   // Turn garbage collection off.
   bool gc = a_machine.IsGCEnabled();
@@ -250,188 +333,442 @@ gmFunctionObject * gmLibHooks::BindLib(gmMachine &a_machine, gmStream &a_stream,
 
   // Load the gmlib header
   if((a_stream.Read(&header, sizeof(header), true) != sizeof(header)) || header.m_id != 'gml0') { goto done; }
-  debug = (header.m_flags & 1);
 
-  // Load the string table
+  functionsOffset = header.m_fnOffset;
   a_stream.Seek(header.m_stOffset);
   if(a_stream.Read(&strings, sizeof(strings), true) != sizeof(strings)) { goto done; }
-  stringTable = new char[strings.m_size];
-  if(a_stream.Read(stringTable, strings.m_size) != strings.m_size) { goto done; }
+
+  // A lazy lib keeps a copy of its string table and function section for binding functions on their
+  // first call, the source section is not kept
+  if(a_lazy && a_stream.GetSize() != (unsigned int) gmStream::ILLEGAL_POS)
+  {
+    if(header.m_fnOffset > a_stream.GetSize() || strings.m_size > header.m_fnOffset) { goto done; }
+    lib = new gmLibImage;
+    memset(lib, 0, sizeof(gmLibImage));
+    lib->m_size = strings.m_size + (a_stream.GetSize() - header.m_fnOffset);
+    lib->m_data = new char[lib->m_size];
+    if(a_stream.Read(lib->m_data, strings.m_size) != strings.m_size) { goto done; }
+    a_stream.Seek(header.m_fnOffset);
+    if(a_stream.Read(lib->m_data + strings.m_size, lib->m_size - strings.m_size) != lib->m_size - strings.m_size) { goto done; }
+    lib->m_stringTableSize = strings.m_size;
+    lib->m_stringTable = lib->m_data;
+    libStream.Open(lib->m_data, lib->m_size);
+    libStream.SetSwapEndianOnWrite(a_stream.GetSwapEndianOnWrite());
+    stream = &libStream;
+    functionsOffset = strings.m_size;
+  }
+  else
+  {
+    // Load the string table, memory backed streams are used in place, otherwise copy the table out
+    lib->m_stringTableSize = strings.m_size;
+    lib->m_stringTable = (const char *) a_stream.ReadDirect(strings.m_size);
+    if(lib->m_stringTable == NULL)
+    {
+      stringTableCopy = new char[strings.m_size];
+      if(a_stream.Read(stringTableCopy, strings.m_size) != strings.m_size) { goto done; }
+      lib->m_stringTable = stringTableCopy;
+    }
+  }
+  lib->m_debug = (header.m_flags & 1);
+  lib->m_swapEndian = a_stream.GetSwapEndianOnWrite();
 
   // Read the source code 
   if(header.m_scOffset && a_machine.GetDebugMode())
   {
+    const char * sourceText;
     a_stream.Seek(header.m_scOffset);
-    if(a_stream.Read(&source, sizeof(source), true) != sizeof(source)) { goto done; }
-    sourceCode = new char[source.m_size];
-    if(a_stream.Read(sourceCode, source.m_size) != source.m_size) { goto done; }
-    sourceCodeId = a_machine.AddSourceCode(sourceCode, a_filename);
-    delete[] sourceCode;
-    sourceCode = NULL;
+    if(!gmLibReadSource(a_stream, sourceText, sourceCode)) { goto done; }
+    lib->m_sourceId = a_machine.AddSourceCode(sourceText, a_filename);
+    if(sourceCode)
+    {
+      delete[] sourceCode;
+      sourceCode = NULL;
+    }
   }
 
   // Read in the functions
-  a_stream.Seek(header.m_fnOffset);
-  if(a_stream.Read(&numFunctions, sizeof(numFunctions), true) != sizeof(numFunctions)) { goto done; }
+  stream->Seek(functionsOffset);
+  if(stream->Read(&numFunctions, sizeof(numFunctions), true) != sizeof(numFunctions)) { goto done; }
 
   // Allocate n function objects.
-  functionObjects = new gmFunctionObject *[numFunctions];
+  lib->m_functions = new gmFunctionObject *[numFunctions];
+  lib->m_numFunctions = numFunctions;
   for(i = 0; i < numFunctions; ++i)
   {
-    functionObjects[i] = a_machine.AllocFunctionObject();
+    lib->m_functions[i] = a_machine.AllocFunctionObject();
   }
 
   // Load each function
   for(i = 0; i < numFunctions; ++i)
   {
-    if((a_stream.Read(&function, sizeof(function), true) != sizeof(function)) || function.m_func != 'func') { goto done; }
-    // Read in the byte code
-    if(byteCode) { delete[] byteCode; }
-    // use the byte code allocation for the debug params and locals symbol array
-    byteCode = new char[function.m_byteCodeLen];
-    if(a_stream.Read(byteCode, function.m_byteCodeLen, true) != function.m_byteCodeLen) { goto done; }
-
-    // Load all symbols
-    union
+    gmFunctionObject * currFunction = NULL;
+    bool root = false;
+    if(lib->m_data)
     {
-      gmuint8 * instruction;
-      gmuint32 * instruction32;
-    };
-
-    instruction = (gmuint8 *) byteCode;
-    gmuint8 * end = instruction + function.m_byteCodeLen;
-    for(;instruction < end;)
+      if(!LoadFunctionStub(a_machine, *stream, *lib, currFunction, root)) { goto done; }
+    }
+    else
     {
-      switch(*(instruction32++))
-      {
-        case BC_BRA :
-        case BC_BRZ :
-        case BC_BRNZ :
-        case BC_BRZK :
-        case BC_BRNZK :
-        case BC_FOREACH :
-        case BC_PUSHINT :
-        case BC_PUSHFP : instruction += sizeof(gmfloat); break;
-
-        case BC_CALL :
-        case BC_GETLOCAL :
-        case BC_SETLOCAL : instruction += sizeof(gmuint32); break;
-
-        case BC_GETDOT :
-        case BC_SETDOT :
-        case BC_GETTHIS :
-        case BC_SETTHIS :
-        case BC_GETGLOBAL :
-        case BC_SETGLOBAL :
-        {
-          gmptr * reference = (gmptr *) instruction; 
-          GM_ASSERT(*reference >= 0 && *reference < (gmptr) strings.m_size);
-          *reference = a_machine.AllocPermanantStringObject(&stringTable[*reference])->GetRef();
-          instruction += sizeof(gmptr);
-          break;
-        }
-        case BC_PUSHSTR :
-        {
-          gmptr * reference = (gmptr *) instruction; 
-          GM_ASSERT(*reference >= 0 && *reference < (gmptr) strings.m_size);
-          *reference = a_machine.AllocStringObject(&stringTable[*reference])->GetRef();
-          instruction += sizeof(gmptr);
-          break;
-        }
+      if(!LoadFunction(a_machine, *stream, *lib, currFunction, root)) { goto done; }
+    }
+    if(root)
+    {
+      functionObject = currFunction;
+    }
+  }
 
-        case BC_PUSHFN :
-        {
-          gmptr * reference = (gmptr *) instruction; 
-          GM_ASSERT(*reference >= 0 && *reference < (gmptr) numFunctions);
-          *reference = functionObjects[*reference]->GetRef();
-          instruction += sizeof(gmptr);
-          break;
-        }
+  error = false;
 
-        default : break;
-      }
-    }
+done:
 
-    // Initialise our function object.
-    gmFunctionInfo functionInfo;
-    gmFunctionObject * currFunction = functionObjects[function.m_id];
-    functionInfo.m_id = currFunction->GetRef();
-    functionInfo.m_root = (function.m_flags & 1);
-    functionInfo.m_byteCode = byteCode;
-    functionInfo.m_byteCodeLength = function.m_byteCodeLen;
-    functionInfo.m_numParams = function.m_numParams;
-    functionInfo.m_numLocals = function.m_numLocals;
-    functionInfo.m_maxStackSize = function.m_maxStackSize;
-    functionInfo.m_symbols = NULL;
-    functionInfo.m_lineInfo = NULL;
-
-    // We have now loaded all objects into the byte code....  Load the debug info
-    if(debug)
-    {
-      gmuint32 stringOffset, lineInfoCount, numSymbols = function.m_numLocals + function.m_numParams;
+  // turn gc off.
+  a_machine.EnableGC(gc);
+  if(stringTableCopy) { delete[] stringTableCopy; }
+  if(sourceCode) { delete[] sourceCode; }
+
+  if(lib == &image)
+  {
+    if(image.m_functions) { delete[] image.m_functions; }
+    if(image.m_byteCode) { delete[] image.m_byteCode; }
+    if(image.m_scratch) { delete[] image.m_scratch; }
+  }
+  else if(lib->m_numUnbound == 0)
+  {
+    // no stubs were made, otherwise the last of them to be bound or destructed frees the image
+    lib->m_numUnbound = 1;
+    ReleaseLib(a_machine, lib);
+  }
 
-      // debug name
-      if(a_stream.Read(&stringOffset, sizeof(stringOffset), true) != sizeof(stringOffset)) { goto done; }
-      GM_ASSERT(stringOffset < strings.m_size);
-      functionInfo.m_debugName = &stringTable[stringOffset];
+  if(error)
+  {
+    a_machine.GetLog().LogEntry("Error loading library");
+    return NULL;
+  }
+  return functionObject;
+}
 
-      // Make sure our scratch memory is large enough
-      if(a_stream.Read(&lineInfoCount, sizeof(lineInfoCount), true) != sizeof(lineInfoCount)) { goto done; }
-      gmuint32 reqdScratchSize = (lineInfoCount * sizeof(gmLineInfo)) + (sizeof(const char *) * numSymbols);
-      if(scratchSize < reqdScratchSize)
+
+bool gmLibHooks::BindFunction(gmMachine &a_machine, gmFunctionObject * a_function)
+{
+  gmLibImage * lib = a_function->m_lib;
+  GM_ASSERT(lib);
+
+  gmStreamBufferStatic stream(lib->m_data, lib->m_size);
+  stream.SetSwapEndianOnWrite(lib->m_swapEndian);
+  stream.Seek(a_function->m_libOffset);
+
+  // Init() collects the full set of references, keep the stub's until it succeeds
+  gmptr * stubReferences = a_function->m_references;
+  int numStubReferences = a_function->m_numReferences;
+  a_function->m_references = NULL;
+  a_function->m_numReferences = 0;
+
+  bool gc = a_machine.IsGCEnabled();
+  a_machine.EnableGC(false);
+
+  gmFunctionObject * function = NULL;
+  bool root;
+  bool result = LoadFunction(a_machine, stream, *lib, function, root) && (function == a_function);
+
+  a_machine.EnableGC(gc);
+
+  if(!result)
+  {
+    a_function->m_references = stubReferences;
+    a_function->m_numReferences = numStubReferences;
+    a_machine.GetLog().LogEntry("Error binding library function");
+    return false;
+  }
+
+  if(stubReferences) { a_machine.Sys_Free(stubReferences); }
+  a_function->m_lib = NULL;
+  ReleaseLib(a_machine, lib);
+  return true;
+}
+
+
+void gmLibHooks::ReleaseLib(gmMachine &a_machine, gmLibImage * a_lib)
+{
+  GM_ASSERT(a_lib->m_numUnbound > 0);
+  if(--a_lib->m_numUnbound == 0)
+  {
+    if(a_lib->m_data) { delete[] a_lib->m_data; }
+    if(a_lib->m_functions) { delete[] a_lib->m_functions; }
+    if(a_lib->m_byteCode) { delete[] a_lib->m_byteCode; }
+    if(a_lib->m_scratch) { delete[] a_lib->m_scratch; }
+    delete a_lib;
+  }
+}
+
+
+bool gmLibHooks::LoadFunction(gmMachine &a_machine, gmStream &a_stream, gmLibImage &a_lib, gmFunctionObject * &a_function, bool &a_root)
+{
+  gmlFunction function;
+  unsigned int j;
+
+  if((a_stream.Read(&function, sizeof(function), true) != sizeof(function)) || function.m_func != 'func') { return false; }
+  if(function.m_id >= a_lib.m_numFunctions) { return false; }
+
+  // Read in the byte code, this is the only part copied out of memory backed streams as it is patched below
+  if(a_lib.m_byteCodeSize < function.m_byteCodeLen)
+  {
+    if(a_lib.m_byteCode) { delete[] a_lib.m_byteCode; }
+    a_lib.m_byteCodeSize = function.m_byteCodeLen;
+    a_lib.m_byteCode = new char[a_lib.m_byteCodeSize];
+  }
+  char * byteCode = a_lib.m_byteCode;
+  if(a_stream.Read(byteCode, function.m_byteCodeLen, true) != function.m_byteCodeLen) { return false; }
+
+  // Load all symbols
+  union
+  {
+    gmuint8 * instruction;
+    gmuint32 * instruction32;
+  };
+
+  instruction = (gmuint8 *) byteCode;
+  gmuint8 * end = instruction + function.m_byteCodeLen;
+  for(;instruction < end;)
+  {
+    switch(*(instruction32++))
+    {
+      case BC_BRA :
+      case BC_BRZ :
+      case BC_BRNZ :
+      case BC_BRZK :
+      case BC_BRNZK :
+      case BC_FOREACH :
+      case BC_PUSHINT :
+      case BC_PUSHFP : instruction += sizeof(gmfloat); break;
+
+      case BC_CALL :
+      case BC_GETLOCAL :
+      case BC_SETLOCAL : instruction += sizeof(gmuint32); break;
+
+      case BC_GETDOT :
+      case BC_SETDOT :
+      case BC_GETTHIS :
+      case BC_SETTHIS :
+      case BC_GETGLOBAL :
+      case BC_SETGLOBAL :
       {
-        scratchSize = reqdScratchSize;
-        delete[] scratch;
-        scratch = new gmuint8[scratchSize];
+        gmptr * reference = (gmptr *) instruction; 
+        GM_ASSERT(*reference >= 0 && *reference < (gmptr) a_lib.m_stringTableSize);
+        *reference = a_machine.AllocPermanantStringObject(&a_lib.m_stringTable[*reference])->GetRef();
+        instruction += sizeof(gmptr);
+        break;
       }
-      gmLineInfo * lineInfo = (gmLineInfo *) scratch;
-      functionInfo.m_lineInfo = lineInfo;
-      functionInfo.m_symbols = (const char **) (scratch + (lineInfoCount * sizeof(gmLineInfo)));
-      functionInfo.m_lineInfoCount = lineInfoCount;
-
-      // Debug line info
-      for(j = 0; j < lineInfoCount; ++j)
+      case BC_PUSHSTR :
       {
-        gmlLineInfo libLineInfo;
-        if(a_stream.Read(&libLineInfo, sizeof(libLineInfo), true) != sizeof(libLineInfo)) { goto done; }
-        lineInfo[j].m_address = libLineInfo.m_byteCodeAddress;
-        lineInfo[j].m_lineNumber = libLineInfo.m_lineNumber;
+        gmptr * reference = (gmptr *) instruction; 
+        GM_ASSERT(*reference >= 0 && *reference < (gmptr) a_lib.m_stringTableSize);
+        gmStringObject * string = a_machine.AllocStringObject(&a_lib.m_stringTable[*reference]);
+#if GM_USE_INCGC
+        // a lazy bind can happen mid collection, keep an existing unreachable string from being freed
+        if(a_lib.m_data) { a_machine.GetGC()->WriteBarrier(string); }
+#endif //GM_USE_INCGC
+        *reference = string->GetRef();
+        instruction += sizeof(gmptr);
+        break;
       }
 
-      // Debug symbols
-      for(j = 0; j < numSymbols; ++j)
+      case BC_PUSHFN :
       {
-        if(a_stream.Read(&stringOffset, sizeof(stringOffset), true) != sizeof(stringOffset)) { goto done; }
-        GM_ASSERT(stringOffset < strings.m_size);
-        functionInfo.m_symbols[j] = &stringTable[stringOffset];
+        gmptr * reference = (gmptr *) instruction; 
+        GM_ASSERT(*reference >= 0 && *reference < (gmptr) a_lib.m_numFunctions);
+        *reference = a_lib.m_functions[*reference]->GetRef();
+        instruction += sizeof(gmptr);
+        break;
       }
 
+      default : break;
     }
+  }
+
+  // Initialise our function object.
+  gmFunctionInfo functionInfo;
+  gmFunctionObject * currFunction = a_lib.m_functions[function.m_id];
+  functionInfo.m_id = currFunction->GetRef();
+  functionInfo.m_root = (function.m_flags & 1);
+  functionInfo.m_byteCode = byteCode;
+  functionInfo.m_byteCodeLength = function.m_byteCodeLen;
+  functionInfo.m_numParams = function.m_numParams;
+  functionInfo.m_numLocals = function.m_numLocals;
+  functionInfo.m_maxStackSize = function.m_maxStackSize;
+  functionInfo.m_symbols = NULL;
+  functionInfo.m_lineInfo = NULL;
+
+  // We have now loaded all objects into the byte code....  Load the debug info
+  if(a_lib.m_debug)
+  {
+    gmuint32 stringOffset, lineInfoCount, numSymbols = function.m_numLocals + function.m_numParams;
 
-    // AND FINALLY, INITIALISE OUR FUNCTION
-    currFunction->Init(&a_machine, debug && a_machine.GetDebugMode(), functionInfo, sourceCodeId);
-    if(functionInfo.m_root)
+    // debug name
+    if(a_stream.Read(&stringOffset, sizeof(stringOffset), true) != sizeof(stringOffset)) { return false; }
+    GM_ASSERT(stringOffset < a_lib.m_stringTableSize);
+    functionInfo.m_debugName = &a_lib.m_stringTable[stringOffset];
+
+    // Make sure our scratch memory is large enough
+    if(a_stream.Read(&lineInfoCount, sizeof(lineInfoCount), true) != sizeof(lineInfoCount)) { return false; }
+    gmuint32 reqdScratchSize = (lineInfoCount * sizeof(gmLineInfo)) + (sizeof(const char *) * numSymbols);
+    if(a_lib.m_scratchSize < reqdScratchSize)
     {
-      functionObject = currFunction;
+      if(a_lib.m_scratch) { delete[] a_lib.m_scratch; }
+      a_lib.m_scratchSize = (reqdScratchSize > 2048) ? reqdScratchSize : 2048;
+      a_lib.m_scratch = new gmuint8[a_lib.m_scratchSize];
+    }
+    gmuint8 * scratch = a_lib.m_scratch;
+    gmLineInfo * lineInfo = (gmLineInfo *) scratch;
+    functionInfo.m_lineInfo = lineInfo;
+    functionInfo.m_symbols = (const char **) (scratch + (lineInfoCount * sizeof(gmLineInfo)));
+    functionInfo.m_lineInfoCount = lineInfoCount;
+
+    // Debug line info, used in place when the stream is memory backed, native endian and aligned
+    const gmlLineInfo * libLineInfos = NULL;
+    if(!a_stream.GetSwapEndianOnWrite())
+    {
+      unsigned int lineInfoPos = a_stream.Tell();
+      libLineInfos = (const gmlLineInfo *) a_stream.ReadDirect(lineInfoCount * sizeof(gmlLineInfo));
+      if(libLineInfos && ((size_t) libLineInfos & (sizeof(gmuint32) - 1)))
+      {
+        a_stream.Seek(lineInfoPos);
+        libLineInfos = NULL;
+      }
+    }
+    if(libLineInfos)
+    {
+      functionInfo.m_lineInfo = (const gmLineInfo *) libLineInfos;
     }
+    else if(lineInfoCount)
+    {
+      // gmlLineInfo and gmLineInfo share a layout, so the whole table is read and swapped in one go
+      unsigned int size = lineInfoCount * sizeof(gmlLineInfo);
+      if(a_stream.Read(lineInfo, size, true) != size) { return false; }
+    }
+
+    // Debug symbols, the offsets are read in bulk into the front of the symbol array, then widened to
+    // pointers from the back so no offset is overwritten before it is used
+    if(numSymbols)
+    {
+      gmuint32 * stringOffsets = (gmuint32 *) functionInfo.m_symbols;
+      unsigned int size = numSymbols * sizeof(gmuint32);
+      if(a_stream.Read(stringOffsets, size, true) != size) { return false; }
+      for(j = numSymbols; j-- > 0;)
+      {
+        stringOffset = stringOffsets[j];
+        GM_ASSERT(stringOffset < a_lib.m_stringTableSize);
+        functionInfo.m_symbols[j] = &a_lib.m_stringTable[stringOffset];
+      }
+    }
+
   }
 
-  error = false;
+  // AND FINALLY, INITIALISE OUR FUNCTION
+  currFunction->Init(&a_machine, a_lib.m_debug && a_machine.GetDebugMode(), functionInfo, a_lib.m_sourceId);
+  a_function = currFunction;
+  a_root = functionInfo.m_root;
+  return true;
+}
 
-done:
 
-  // turn gc off.
-  a_machine.EnableGC(gc);
-  if(stringTable) { delete[] stringTable; }
-  if(sourceCode) { delete[] sourceCode; }
-  if(functionObjects) { delete[] functionObjects; }
-  if(byteCode) { delete[] byteCode; }
-  if(scratch) { delete[] scratch; }
+bool gmLibHooks::LoadFunctionStub(gmMachine &a_machine, gmStream &a_stream, gmLibImage &a_lib, gmFunctionObject * &a_function, bool &a_root)
+{
+  gmlFunction function;
+  unsigned int offset = a_stream.Tell();
 
-  if(error)
+  if((a_stream.Read(&function, sizeof(function), true) != sizeof(function)) || function.m_func != 'func') { return false; }
+  if(function.m_id >= a_lib.m_numFunctions) { return false; }
+
+  const char * byteCode = (const char *) a_stream.ReadDirect(function.m_byteCodeLen);
+  if(byteCode == NULL) { return false; }
+
+  // skip the debug info, it is read when the function is bound
+  if(a_lib.m_debug)
   {
-    a_machine.GetLog().LogEntry("Error loading library");
-    return NULL;
+    gmuint32 stringOffset, lineInfoCount, numSymbols = function.m_numLocals + function.m_numParams;
+    if(a_stream.Read(&stringOffset, sizeof(stringOffset), true) != sizeof(stringOffset)) { return false; }
+    if(a_stream.Read(&lineInfoCount, sizeof(lineInfoCount), true) != sizeof(lineInfoCount)) { return false; }
+    if(a_stream.ReadDirect((lineInfoCount * sizeof(gmlLineInfo)) + (numSymbols * sizeof(gmuint32))) == NULL) { return false; }
   }
-  return functionObject;
+
+  // the stub references the functions its byte code creates, so they live as long as it does
+  gmuint32 * references = (gmuint32 *) a_lib.m_scratch;
+  int numReferences = 0;
+  if(a_lib.m_scratchSize < function.m_byteCodeLen)
+  {
+    if(a_lib.m_scratch) { delete[] a_lib.m_scratch; }
+    a_lib.m_scratchSize = function.m_byteCodeLen;
+    a_lib.m_scratch = new gmuint8[a_lib.m_scratchSize];
+    references = (gmuint32 *) a_lib.m_scratch;
+  }
+
+  const char * instruction = byteCode;
+  const char * end = byteCode + function.m_byteCodeLen;
+  while(instruction < end)
+  {
+    gmuint32 op = gmLibRead32(instruction, a_lib.m_swapEndian);
+    instruction += sizeof(gmuint32);
+    switch(op)
+    {
+      case BC_BRA :
+      case BC_BRZ :
+      case BC_BRNZ :
+      case BC_BRZK :
+      case BC_BRNZK :
+      case BC_FOREACH :
+      case BC_PUSHINT :
+      case BC_PUSHFP :
+      case BC_CALL :
+      case BC_GETLOCAL :
+      case BC_SETLOCAL :
+      case BC_GETDOT :
+      case BC_SETDOT :
+      case BC_GETTHIS :
+      case BC_SETTHIS :
+      case BC_GETGLOBAL :
+      case BC_SETGLOBAL :
+      case BC_PUSHSTR : instruction += sizeof(gmuint32); break;
+
+      case BC_PUSHFN :
+      {
+        gmuint32 id = gmLibRead32(instruction, a_lib.m_swapEndian);
+        instruction += sizeof(gmuint32);
+        if(id >= a_lib.m_numFunctions) { return false; }
+        int i;
+        for(i = 0; i < numReferences; ++i)
+        {
+          if(references[i] == id) break;
+        }
+        if(i == numReferences) references[numReferences++] = id;
+        break;
+      }
+
+      default : break;
+    }
+  }
+
+  gmFunctionObject * currFunction = a_lib.m_functions[function.m_id];
+  if(currFunction->m_lib) { return false; } // duplicate function id
+
+  if(numReferences > 0)
+  {
+    currFunction->m_references = (gmptr *) a_machine.Sys_Alloc(sizeof(gmptr) * numReferences);
+    for(int i = 0; i < numReferences; ++i)
+    {
+      currFunction->m_references[i] = a_lib.m_functions[references[i]]->GetRef();
+    }
+    currFunction->m_numReferences = numReferences;
+  }
+
+  currFunction->m_maxStackSize = function.m_maxStackSize;
+  currFunction->m_numLocals = function.m_numLocals;
+  currFunction->m_numParams = function.m_numParams;
+  currFunction->m_numParamsLocals = function.m_numParams + function.m_numLocals;
+  currFunction->m_lib = &a_lib;
+  currFunction->m_libOffset = offset;
+  ++a_lib.m_numUnbound;
+
+  a_function = currFunction;
+  a_root = (function.m_flags & 1);
+  return true;
 }
@@ -12,6 +12,7 @@
 #include "gmConfig.h"
 #include "gmCodeGenHooks.h"
 #include "gmListDouble.h"
+#include "gmHash.h"
 #include "gmMemChain.h"
 #include "gmStream.h"
 #include "gmStreamBuffer.h"
@@ -19,6 +20,26 @@
 class gmMachine;
 class gmFunctionObject;
 
+/// \struct gmLibImage
+/// \brief gmLibImage is a lib kept in memory by a lazy BindLib() until all of its functions are bound.
+struct gmLibImage
+{
+  char * m_data; //!< copy of the string table then the function section, NULL for libs bound up front
+  unsigned int m_size;
+  const char * m_stringTable;
+  gmuint32 m_stringTableSize;
+  gmFunctionObject ** m_functions;
+  gmuint32 m_numFunctions;
+  gmuint32 m_sourceId;
+  bool m_debug;
+  bool m_swapEndian;
+  int m_numUnbound; //!< functions still referencing the image
+  char * m_byteCode; //!< patch buffer reused between functions
+  gmuint32 m_byteCodeSize;
+  gmuint8 * m_scratch; //!< debug info buffer reused between functions
+  gmuint32 m_scratchSize;
+};
+
 /// \class gmLibHooks
 /// \brief gmLibHooks is a compiler hook class that allows compiling to a lib for disk storage.
 class gmLibHooks : public gmCodeGenHooks
@@ -26,7 +47,8 @@ class gmLibHooks : public gmCodeGenHooks
 public:
 
   // a_source and must exist untill destruction of the libhooks
-  gmLibHooks(gmStream &a_stream, const char * a_source); 
+  // a_compressSource stores the debug source gmLZ compressed, see gmLZ.h
+  gmLibHooks(gmStream &a_stream, const char * a_source, bool a_compressSource = false); 
   virtual ~gmLibHooks();
 
   virtual bool Begin(bool a_debug);
@@ -38,15 +60,33 @@ public:
   virtual bool SwapEndian() const { return m_stream->GetSwapEndianOnWrite(); }
 
   /// \brief BindLib will bind the lib to the machine, and return the root function for executing.
-  static gmFunctionObject * BindLib(gmMachine &a_machine, gmStream &a_stream, const char * a_filename);
+  /// \param a_lazy when true, functions are only registered and their byte code is loaded on their first call.
+  static gmFunctionObject * BindLib(gmMachine &a_machine, gmStream &a_stream, const char * a_filename, bool a_lazy = false);
+
+  /// \brief ReadSource will read the source code of a debug lib without binding it.
+  /// \param a_source is set to the null terminated source, or NULL if the lib has none. It points into memory
+  ///        backed streams, otherwise into a_copy.
+  /// \param a_copy is set to a buffer allocated with new[] when the source had to be copied or decompressed.
+  /// \return false if the lib is invalid.
+  static bool ReadSource(gmStream &a_stream, const char * &a_source, char * &a_copy);
+
+  /// \brief BindFunction will load a function registered by a lazy BindLib().
+  static bool BindFunction(gmMachine &a_machine, gmFunctionObject * a_function);
+
+  /// \brief ReleaseLib is called as each lazily bound function is bound or destructed.
+  static void ReleaseLib(gmMachine &a_machine, gmLibImage * a_lib);
 
 private:
 
-  class USymbol : public gmListDoubleNode<USymbol>
+  static bool LoadFunction(gmMachine &a_machine, gmStream &a_stream, gmLibImage &a_lib, gmFunctionObject * &a_function, bool &a_root);
+  static bool LoadFunctionStub(gmMachine &a_machine, gmStream &a_stream, gmLibImage &a_lib, gmFunctionObject * &a_function, bool &a_root);
+
+  class USymbol : public gmListDoubleNode<USymbol>, public gmHashNode<const char *, USymbol>
   {
   public: 
     USymbol();
     ~USymbol();
+    inline const char * GetKey() const { return m_string; }
     char * m_string;
     gmptr m_offset; // offset into symbol table.
   };
@@ -54,11 +94,13 @@ private:
   gmStream * m_stream;
   bool m_swapEndian;
   bool m_debug;
+  bool m_compressSource;
   const char * m_source;
   gmptr m_symbolOffset;
   gmptr m_functionId;
   gmStreamBufferDynamic m_functionStream;
-  gmListDouble<USymbol> m_symbols;
+  gmListDouble<USymbol> m_symbols; // in string table order, newest first
+  gmHash<const char *, USymbol> m_symbolHash;
   gmMemChain m_allocator;
 };
 
@@ -84,8 +126,16 @@ private:
   source_code
   {
     source_code_size          [4 bytes]
-    flags                     [4 bytes] // possibly encryption and compression flags
-    data                      [1 byte ] * source code size.
+    flags                     [4 bytes] // 0x01 - gmLZ compressed
+    if(gmLZ compressed)
+    {
+      compressed_size         [4 bytes]
+      data                    [1 byte ] * compressed_size, decompresses to source code size.
+    }
+    else
+    {
+      data                    [1 byte ] * source code size.
+    }
   }
 
   functions
@@ -153,6 +153,7 @@ void GM_CDECL gmMachine::ScanRootsCallBack(gmMachine* a_machine, gmGarbageCollec
   // iterate over all threads and mark the stacks.
   for(tit = a_machine->m_runningThreads.GetFirst(); a_machine->m_runningThreads.IsValid(tit); tit = a_machine->m_runningThreads.GetNext(tit)) tit->GCScanRoots(a_machine, a_gc);
   for(tit = a_machine->m_blockedThreads.GetFirst(); a_machine->m_blockedThreads.IsValid(tit); tit = a_machine->m_blockedThreads.GetNext(tit)) tit->GCScanRoots(a_machine, a_gc);
+  for(tit = a_machine->m_pendingThreads.GetFirst(); a_machine->m_pendingThreads.IsValid(tit); tit = a_machine->m_pendingThreads.GetNext(tit)) tit->GCScanRoots(a_machine, a_gc);
   for(tit = a_machine->m_sleepingThreads.GetFirst(); a_machine->m_sleepingThreads.IsValid(tit); tit = a_machine->m_sleepingThreads.GetNext(tit)) tit->GCScanRoots(a_machine, a_gc);
   for(tit = a_machine->m_exceptionThreads.GetFirst(); a_machine->m_exceptionThreads.IsValid(tit); tit = a_machine->m_sleepingThreads.GetNext(tit)) tit->GCScanRoots(a_machine, a_gc);
 
@@ -184,11 +185,10 @@ gmMachine::gmMachine()
     m_memTableObj(sizeof(gmTableObject), GMMACHINE_TBLCHUNKSIZE),
     m_memFunctionObj(sizeof(gmFunctionObject), GMMACHINE_OBJECTCHUNKSIZE),
     m_memUserObj(sizeof(gmUserObject), GMMACHINE_OBJECTCHUNKSIZE),
-    m_memStackFrames(sizeof(gmStackFrame), GMMACHINE_STACKFCHUNKSIZE),
 
-    m_threads(128),
+    m_threads(128, true),
     m_strings(GMMACHINE_STRINGHASHSIZE),
-    m_blocks(64)
+    m_blocks(64, true)
 
 {
   m_line = NULL;
@@ -208,6 +208,12 @@ gmMachine::gmMachine()
   m_objects = NULL;
   m_threadId = 0;
   m_nextThread = NULL;
+  m_threadBudget = 0;
+  m_sleepOrder = 0;
+  m_numFreeThreads = 0;
+  m_maxFreeThreads = GMMACHINE_MAXKILLEDTHREADS;
+  m_freeThreadsLowWater = 0;
+  m_trimTime = GMMACHINE_THREADTRIMTIME;
   m_autoMem = GMMACHINE_AUTOMEM;
   m_currentMemoryUsage = 0;
   m_desiredByteMemoryUsageHard = GMMACHINE_INITIALGCHARDLIMIT;
@@ -218,9 +224,15 @@ gmMachine::gmMachine()
   m_statsGCFullCollect = 0;
   m_statsGCIncCollect = 0;
   m_statsGCWarnings = 0;
+  m_statsGlobalCacheHits = 0;
+  m_statsGlobalCacheMisses = 0;
+  m_statsThreadsCreated = 0;
+  m_statsThreadsReused = 0;
 
   m_debug = false;
   m_debugUser = NULL;
+  m_codeTree = NULL;
+  m_codeGen = NULL;
 
   m_gcEnabled = true;
 
@@ -242,6 +254,8 @@ gmMachine::~gmMachine()
 #if GM_USE_INCGC
   delete m_gc;
 #endif //GM_USE_INCGC
+  _gmSafeDelete(m_codeTree);
+  _gmSafeDelete(m_codeGen);
 }
 
 
@@ -289,12 +303,17 @@ void gmMachine::ResetAndFreeMemory()
   // threads
   m_runningThreads.RemoveAll();
   m_blockedThreads.RemoveAll();
+  m_pendingThreads.RemoveAll();
   m_sleepingThreads.RemoveAll();
+  m_sleepHeap.ResetAndFreeMemory();
   m_exceptionThreads.RemoveAll();
   m_killedThreads.RemoveAndDeleteAll();
   m_threads.RemoveAndDeleteAll();
   m_threadId = 0;
   m_time = 0;
+  m_numFreeThreads = 0;
+  m_freeThreadsLowWater = 0;
+  m_trimTime = GMMACHINE_THREADTRIMTIME;
   m_nextThread = NULL;
   GM_ASSERT(m_blocks.Count() == 0);
 
@@ -312,9 +331,6 @@ void gmMachine::ResetAndFreeMemory()
   GM_ASSERT(m_memUserObj.GetMemUsed() == 0);
   m_memUserObj.ResetAndFreeMemory();
 
-  GM_ASSERT(m_memStackFrames.GetMemUsed() == 0);
-  m_memStackFrames.ResetAndFreeMemory();
-
   GM_ASSERT(m_fixedSet.GetMemUsed() == 0);
   m_fixedSet.ResetAndFreeMemory();
 
@@ -327,8 +343,8 @@ void gmMachine::ResetAndFreeMemory()
 
   // compiler
   m_log.ResetAndFreeMemory();
-  gmCodeTree::Get().FreeMemory();
-  gmCodeGen::Get().FreeMemory();
+  if(m_codeTree) { m_codeTree->FreeMemory(); }
+  if(m_codeGen) { m_codeGen->FreeMemory(); }
 
   // garbage collection
   m_autoMem = GMMACHINE_AUTOMEM;
@@ -478,6 +494,14 @@ bool gmMachine::RegisterTypeOperator(gmType a_type, gmOperator a_operator, gmFun
   else if(a_nativeFunction)
   {
     m_types[a_type].m_nativeOperators[a_operator] = a_nativeFunction;
+    if(a_type == GM_INT || a_type == GM_FLOAT)
+    {
+      m_defaultNumberOperators = false;
+    }
+    if(a_type == GM_TABLE && (a_operator == O_GETDOT || a_operator == O_SETDOT))
+    {
+      m_defaultTableOperators = false;
+    }
   }
   return true;
 }
@@ -491,30 +515,42 @@ const char * gmMachine::GetTypeName(gmType a_type)
 
 
 
+void gmMachine::AllocCompiler()
+{
+  if(m_codeTree == NULL)
+  {
+    m_codeTree = new gmCodeTree;
+    m_codeGen = gmCodeGen::Create();
+  }
+}
+
+
+
 int gmMachine::CheckSyntax(const char * a_string)
 {
   m_log.Reset();
+  AllocCompiler();
   gmCodeGenHooksNull nullHooks;
 
   // parse
-  int errors = gmCodeTree::Get().Lock(a_string, &m_log);
+  int errors = m_codeTree->Lock(a_string, &m_log);
   if(errors > 0) 
   {
-    gmCodeTree::Get().Unlock();
+    m_codeTree->Unlock();
     return errors;
   }
 
   // compile
-  errors = gmCodeGen::Get().Lock(gmCodeTree::Get().GetCodeTree(), &nullHooks, true, &m_log);
+  errors = m_codeGen->Lock(m_codeTree->GetCodeTree(), &nullHooks, true, &m_log);
   if(errors > 0)
   {
-    gmCodeTree::Get().Unlock();
-    gmCodeGen::Get().Unlock();
+    m_codeTree->Unlock();
+    m_codeGen->Unlock();
     return errors;
   }
 
-  gmCodeTree::Get().Unlock();
-  gmCodeGen::Get().Unlock();
+  m_codeTree->Unlock();
+  m_codeGen->Unlock();
 
   return errors;
 }
@@ -524,28 +560,29 @@ int gmMachine::CheckSyntax(const char * a_string)
 int gmMachine::ExecuteString(const char * a_string, int * a_threadId, bool a_now, const char * a_filename, gmVariable* a_this)
 {
   m_log.Reset();
+  AllocCompiler();
   if(a_threadId) { *a_threadId = GM_INVALID_THREAD; }
 
   // parse
-  int errors = gmCodeTree::Get().Lock(a_string, &m_log);
+  int errors = m_codeTree->Lock(a_string, &m_log);
   if(errors > 0) 
   {
-    gmCodeTree::Get().Unlock();
+    m_codeTree->Unlock();
     return errors;
   }
 
   // compile
   gmHooks hooks(this, a_string, a_filename);
-  errors = gmCodeGen::Get().Lock(gmCodeTree::Get().GetCodeTree(), &hooks, m_debug, &m_log);
+  errors = m_codeGen->Lock(m_codeTree->GetCodeTree(), &hooks, m_debug, &m_log);
   if(errors > 0)
   {
-    gmCodeTree::Get().Unlock();
-    gmCodeGen::Get().Unlock();
+    m_codeTree->Unlock();
+    m_codeGen->Unlock();
     return errors;
   }
 
-  gmCodeTree::Get().Unlock();
-  gmCodeGen::Get().Unlock();
+  m_codeTree->Unlock();
+  m_codeGen->Unlock();
 
   // null or this
   gmVariable thisVar;
@@ -570,9 +607,9 @@ int gmMachine::ExecuteString(const char * a_string, int * a_threadId, bool a_now
 }
 
 
-bool gmMachine::ExecuteLib(gmStream &a_stream, int * a_threadId, bool a_now, const char * a_filename, gmVariable* a_this)
+bool gmMachine::ExecuteLib(gmStream &a_stream, int * a_threadId, bool a_now, const char * a_filename, gmVariable* a_this, bool a_lazy)
 {
-  gmFunctionObject * rootFunction = gmLibHooks::BindLib(*this, a_stream, a_filename);
+  gmFunctionObject * rootFunction = gmLibHooks::BindLib(*this, a_stream, a_filename, a_lazy);
   if(rootFunction)
   {
     // null or this
@@ -618,28 +655,29 @@ bool gmMachine::ExecuteFunction(gmFunctionObject * a_function, int * a_threadId,
 }
 
 
-int gmMachine::CompileStringToLib(const char * a_string, gmStream &a_stream)
+int gmMachine::CompileStringToLib(const char * a_string, gmStream &a_stream, bool a_compressSource)
 {
   m_log.Reset();
+  AllocCompiler();
 
   // parse
-  int errors = gmCodeTree::Get().Lock(a_string, &m_log);
+  int errors = m_codeTree->Lock(a_string, &m_log);
   if(errors > 0) 
   {
-    gmCodeTree::Get().Unlock();
+    m_codeTree->Unlock();
     return errors;
   }
 /*
   FILE * fp = fopen("d:/temp/codetree.txt", "wb");
-  gmCodeTree::Get().Print(gmCodeTree::Get().GetCodeTree(), fp);
+  m_codeTree->Print(m_codeTree->GetCodeTree(), fp);
   fclose(fp);
 */
   // compile
-  gmLibHooks hooks(a_stream, a_string);
-  errors = gmCodeGen::Get().Lock(gmCodeTree::Get().GetCodeTree(), &hooks, m_debug, &m_log);
+  gmLibHooks hooks(a_stream, a_string, a_compressSource);
+  errors = m_codeGen->Lock(m_codeTree->GetCodeTree(), &hooks, m_debug, &m_log);
 
-  gmCodeTree::Get().Unlock();
-  gmCodeGen::Get().Unlock();
+  m_codeTree->Unlock();
+  m_codeGen->Unlock();
 
   return errors;
 }
@@ -648,12 +686,13 @@ int gmMachine::CompileStringToLib(const char * a_string, gmStream &a_stream)
 gmFunctionObject * gmMachine::CompileStringToFunction(const char * a_string, int *a_errorCount, const char * a_filename)
 {
   m_log.Reset();
+  AllocCompiler();
 
   // parse
-  int errors = gmCodeTree::Get().Lock(a_string, &m_log);
+  int errors = m_codeTree->Lock(a_string, &m_log);
   if(errors > 0) 
   {
-    gmCodeTree::Get().Unlock();
+    m_codeTree->Unlock();
     if(a_errorCount) 
       *a_errorCount = errors;
     return NULL;
@@ -661,18 +700,18 @@ gmFunctionObject * gmMachine::CompileStringToFunction(const char * a_string, int
 
   // compile
   gmHooks hooks(this, a_string, a_filename);
-  errors = gmCodeGen::Get().Lock(gmCodeTree::Get().GetCodeTree(), &hooks, m_debug, &m_log);
+  errors = m_codeGen->Lock(m_codeTree->GetCodeTree(), &hooks, m_debug, &m_log);
   if(errors > 0)
   {
-    gmCodeTree::Get().Unlock();
-    gmCodeGen::Get().Unlock();
+    m_codeTree->Unlock();
+    m_codeGen->Unlock();
     if(a_errorCount) 
       *a_errorCount = errors;
     return NULL;
   }
 
-  gmCodeTree::Get().Unlock();
-  gmCodeGen::Get().Unlock();
+  m_codeTree->Unlock();
+  m_codeGen->Unlock();
 
   if(a_errorCount) 
     *a_errorCount = errors;
@@ -698,6 +737,12 @@ gmThread * gmMachine::CreateThread(int * a_threadId)
   if(thread == NULL)
   {
     thread = new gmThread(this);
+    ++m_statsThreadsCreated;
+  }
+  else
+  {
+    ++m_statsThreadsReused;
+    if(m_freeThreadsLowWater > --m_numFreeThreads) m_freeThreadsLowWater = m_numFreeThreads;
   }
   thread->Sys_Reset(GetThreadId());
   if(a_threadId) *a_threadId = thread->GetId();
@@ -726,44 +771,62 @@ gmThread * gmMachine::GetThread(int a_threadId)
 
 bool gmMachine::Signal(const gmVariable &a_signal, int a_dstThreadId, int a_srcThreadId)
 {
-  gmBlockList * blockList = m_blocks.Find(a_signal);
-  bool used = false;
-
-  if(blockList)
+  if(a_dstThreadId != GM_INVALID_THREAD)
   {
-    // iterate over all threads in the block list, and add the signal to the appropriate threads.
-    gmBlock * block = blockList->m_blocks.GetFirst();
-    while(blockList->m_blocks.IsValid(block))
+    // find the block on the thread itself, rather than search the wait list of every thread blocked on the signal.
+    // blocks are on both lists newest first, so this finds the same block.
+    gmThread * thread = GetThread(a_dstThreadId);
+    gmBlock * block = (thread) ? thread->Sys_GetBlocks() : NULL;
+    while(block)
     {
-      gmThread * thread = block->m_thread;
-      if(a_dstThreadId == GM_INVALID_THREAD || a_dstThreadId == thread->GetId())
+      if(block->m_block.m_type == a_signal.m_type && block->m_block.m_value.m_ref == a_signal.m_value.m_ref)
       {
-        gmSignal * signal = NULL;
-        used = true;
-
-        // allocate a signal
-        if(thread->GetState() == gmThread::SYS_PENDING)
-        {
-          signal = (gmSignal *) Sys_Alloc(sizeof(gmSignal));
-          signal->m_signal = a_signal;
-          signal->m_srcThreadId = a_srcThreadId;
-          signal->m_dstThreadId = a_dstThreadId;
-          signal->m_nextSignal = thread->Sys_GetSignals();
-          thread->Sys_SetSignals(signal);
-        }
-        else
-        {
-          block->m_signalled = true;
-          block->m_srcThreadId = a_srcThreadId;
-          thread->Sys_SetState(gmThread::SYS_PENDING);
-        }
-
-        if(a_dstThreadId != GM_INVALID_THREAD) break;
+        Sys_SignalBlock(block, a_signal, a_dstThreadId, a_srcThreadId);
+        return true;
       }
-      block = blockList->m_blocks.GetNext(block);
+      block = block->m_nextBlock;
     }
+    return false;
+  }
+
+  gmBlockList * blockList = m_blocks.Find(a_signal);
+  if(blockList == NULL) return false;
+
+  // iterate over all threads in the block list, and add the signal to them.
+  gmBlock * block = blockList->m_blocks.GetFirst();
+  while(blockList->m_blocks.IsValid(block))
+  {
+    Sys_SignalBlock(block, a_signal, a_dstThreadId, a_srcThreadId);
+    block = blockList->m_blocks.GetNext(block);
+  }
+  return true;
+}
+
+
+
+void gmMachine::Sys_SignalBlock(gmBlock * a_block, const gmVariable &a_signal, int a_dstThreadId, int a_srcThreadId)
+{
+  gmThread * thread = a_block->m_thread;
+
+  // allocate a signal
+  if(thread->GetState() == gmThread::SYS_PENDING)
+  {
+    gmSignal * signal = (gmSignal *) Sys_Alloc(sizeof(gmSignal));
+    signal->m_signal = a_signal;
+    signal->m_srcThreadId = a_srcThreadId;
+    signal->m_dstThreadId = a_dstThreadId;
+    signal->m_nextSignal = thread->Sys_GetSignals();
+    thread->Sys_SetSignals(signal);
+  }
+  else if(thread->GetState() == gmThread::BLOCKED)
+  {
+    // queue the thread for Execute() to wake, only blocked threads are on the blocked list
+    a_block->m_signalled = true;
+    a_block->m_srcThreadId = a_srcThreadId;
+    m_blockedThreads.Remove(thread);
+    m_pendingThreads.InsertLast(thread);
+    thread->Sys_SetState(gmThread::SYS_PENDING);
   }
-  return used;
 }
 
 
@@ -852,6 +915,13 @@ void gmMachine::ForEachThread(gmThreadIteratorCallback a_callback, void * a_cont
     if(!a_callback(thread, a_context)) return;
   }
 
+  for(it = m_pendingThreads.First(); it;)
+  {
+    gmThread * thread = it.Resolve();
+    ++it;
+    if(!a_callback(thread, a_context)) return;
+  }
+
   for(it = m_sleepingThreads.First(); it;)
   {
     gmThread * thread = it.Resolve();
@@ -885,15 +955,25 @@ void gmMachine::Sys_SwitchState(gmThread * a_thread, int a_to)
       break;
     }
     case gmThread::BLOCKED :
-    case gmThread::SYS_PENDING :
     {
       // remove and clean up the blocks.
       Sys_RemoveBlocks(a_thread);
       m_blockedThreads.Remove(a_thread);
       break;
     } 
-    case gmThread::SLEEPING : m_sleepingThreads.Remove(a_thread); break;
-    case gmThread::KILLED : m_killedThreads.Remove(a_thread); break;
+    case gmThread::SYS_PENDING :
+    {
+      Sys_RemoveBlocks(a_thread);
+      m_pendingThreads.Remove(a_thread);
+      break;
+    }
+    case gmThread::SLEEPING :
+    {
+      Sys_SleepHeapRemove(a_thread);
+      m_sleepingThreads.Remove(a_thread);
+      break;
+    }
+    case gmThread::KILLED : m_killedThreads.Remove(a_thread); --m_numFreeThreads; break;
     case gmThread::EXCEPTION : m_exceptionThreads.Remove(a_thread); break;
     default : GM_ASSERT(0); break;
   }
@@ -904,20 +984,8 @@ void gmMachine::Sys_SwitchState(gmThread * a_thread, int a_to)
     case gmThread::EXCEPTION : m_exceptionThreads.InsertFirst(a_thread); break;
     case gmThread::SLEEPING :
     {
-      // insert ordered by thread time stamp (GetTimeStamp)
-      gmListDouble<gmThread>::Iterator it = m_sleepingThreads.First();
-      bool inserted = false;
-      while(it)
-      {
-        if(it->GetTimeStamp() > a_thread->GetTimeStamp())
-        {
-          m_sleepingThreads.InsertBefore(it.Resolve(), a_thread);
-          inserted = true;
-          break;
-        }
-        ++it;
-      }
-      if(!inserted) m_sleepingThreads.InsertLast(a_thread);
+      m_sleepingThreads.InsertLast(a_thread);
+      Sys_SleepHeapInsert(a_thread);
       break;
     }
     case gmThread::KILLED : 
@@ -931,9 +999,10 @@ void gmMachine::Sys_SwitchState(gmThread * a_thread, int a_to)
       m_threads.Remove(a_thread);
       a_thread->Sys_Reset(0);
 
-      if(m_killedThreads.Count() < GMMACHINE_MAXKILLEDTHREADS)
+      if(m_numFreeThreads < m_maxFreeThreads)
       {
         m_killedThreads.InsertFirst(a_thread); 
+        ++m_numFreeThreads;
         break;
       }
       delete a_thread;
@@ -945,6 +1014,119 @@ void gmMachine::Sys_SwitchState(gmThread * a_thread, int a_to)
 }
 
 
+// sleeping threads wake in time stamp order, and threads with the same time stamp in the order they slept
+static inline bool gmWakesBefore(const gmThread * a_threadA, const gmThread * a_threadB)
+{
+  if(a_threadA->GetTimeStamp() != a_threadB->GetTimeStamp())
+  {
+    return a_threadA->GetTimeStamp() < a_threadB->GetTimeStamp();
+  }
+  return (int) (a_threadA->Sys_GetSleepOrder() - a_threadB->Sys_GetSleepOrder()) < 0;
+}
+
+
+
+void gmMachine::Sys_SleepHeapInsert(gmThread * a_thread)
+{
+  a_thread->Sys_SetSleepOrder(m_sleepOrder++);
+  m_sleepHeap.InsertLast(a_thread);
+  Sys_SleepHeapUp(m_sleepHeap.Count() - 1);
+}
+
+
+
+void gmMachine::Sys_SleepHeapRemove(gmThread * a_thread)
+{
+  int index = a_thread->Sys_GetSleepIndex();
+  int last = m_sleepHeap.Count() - 1;
+  GM_ASSERT(index >= 0 && m_sleepHeap[index] == a_thread);
+  a_thread->Sys_SetSleepIndex(-1);
+
+  // fill the hole with the last thread, and move that up or down to its place
+  gmThread * thread = m_sleepHeap[last];
+  m_sleepHeap.RemoveLast();
+  if(index != last)
+  {
+    m_sleepHeap[index] = thread;
+    if(index > 0 && gmWakesBefore(thread, m_sleepHeap[(index - 1) / 2]))
+    {
+      Sys_SleepHeapUp(index);
+    }
+    else
+    {
+      Sys_SleepHeapDown(index);
+    }
+  }
+}
+
+
+
+void gmMachine::Sys_SleepHeapUp(int a_index)
+{
+  gmThread * thread = m_sleepHeap[a_index];
+  while(a_index > 0)
+  {
+    int parent = (a_index - 1) / 2;
+    if(!gmWakesBefore(thread, m_sleepHeap[parent])) break;
+    m_sleepHeap[a_index] = m_sleepHeap[parent];
+    m_sleepHeap[a_index]->Sys_SetSleepIndex(a_index);
+    a_index = parent;
+  }
+  m_sleepHeap[a_index] = thread;
+  thread->Sys_SetSleepIndex(a_index);
+}
+
+
+
+void gmMachine::Sys_SleepHeapDown(int a_index)
+{
+  int count = m_sleepHeap.Count();
+  gmThread * thread = m_sleepHeap[a_index];
+  for(;;)
+  {
+    int child = a_index * 2 + 1;
+    if(child >= count) break;
+    if(child + 1 < count && gmWakesBefore(m_sleepHeap[child + 1], m_sleepHeap[child])) ++child;
+    if(!gmWakesBefore(m_sleepHeap[child], thread)) break;
+    m_sleepHeap[a_index] = m_sleepHeap[child];
+    m_sleepHeap[a_index]->Sys_SetSleepIndex(a_index);
+    a_index = child;
+  }
+  m_sleepHeap[a_index] = thread;
+  thread->Sys_SetSleepIndex(a_index);
+}
+
+
+
+void gmMachine::SetMaxFreeThreads(int a_maxFreeThreads)
+{
+  m_maxFreeThreads = (a_maxFreeThreads > 0) ? a_maxFreeThreads : 0;
+  while(m_numFreeThreads > m_maxFreeThreads)
+  {
+    delete m_killedThreads.RemoveLast();
+    --m_numFreeThreads;
+  }
+  if(m_freeThreadsLowWater > m_numFreeThreads) m_freeThreadsLowWater = m_numFreeThreads;
+}
+
+
+
+void gmMachine::Sys_TrimFreeThreads()
+{
+  // free threads that were not needed since the last trim are surplus, let half of them go, least recently killed
+  // first, so an idle free list drains over a few trims while a steady load keeps what it uses
+  int numTrim = (m_freeThreadsLowWater + 1) / 2;
+  while(numTrim-- > 0)
+  {
+    delete m_killedThreads.RemoveLast();
+    --m_numFreeThreads;
+  }
+  m_freeThreadsLowWater = m_numFreeThreads;
+  m_trimTime = m_time + GMMACHINE_THREADTRIMTIME;
+}
+
+
+
 void gmMachine::KillExceptionThreads()
 {
   gmThread * thread = m_exceptionThreads.GetLast();
@@ -958,57 +1140,78 @@ void gmMachine::KillExceptionThreads()
 
 
 int gmMachine::Execute(gmuint32 a_delta)
+{
+  return ExecuteBudget(a_delta, 0);
+}
+
+
+
+int gmMachine::ExecuteBudget(gmuint32 a_delta, gmuint32 a_maxMicros, int * a_numDeferred)
 {
   m_time += a_delta;
 
   //
   // Wake up any sleeping threads at their timestamp
   //
-  for(;;)
+  while(m_sleepHeap.Count() && m_sleepHeap[0]->GetTimeStamp() <= m_time)
   {
-    gmThread * thread = m_sleepingThreads.GetFirst();
-    if(m_sleepingThreads.IsValid(thread) && (thread->GetTimeStamp() <= m_time))
-    {
-      Sys_SwitchState(thread, gmThread::RUNNING);
-      continue;
-    }
-    break;
+    Sys_SwitchState(m_sleepHeap[0], gmThread::RUNNING);
   }
 
   //
-  // Move all SYS_PENDING threads from the blocked list to the front of the RUNNING list.
+  // Move all SYS_PENDING threads to the end of the RUNNING list, in the order they were signalled.
   //
-  gmThread * it, * nit;
-  for(it = m_blockedThreads.GetFirst(); m_blockedThreads.IsValid(it);)
+  gmThread * it;
+  for(it = m_pendingThreads.GetFirst(); m_pendingThreads.IsValid(it); it = m_pendingThreads.GetFirst())
   {
-    nit = m_blockedThreads.GetNext(it);
-    if(it->GetState() == gmThread::SYS_PENDING)
+    // get the unblocking signal
+    gmBlock * block = it->Sys_GetBlocks();
+    while(block)
     {
-      // get the unblocking signal
-      gmBlock * block = it->Sys_GetBlocks();
-      while(block)
-      {
-        if(block->m_signalled) break;
-        block = block->m_nextBlock;
-      }
-      GM_ASSERT(block);
-      it->Pop();
-      it->Push(block->m_block);
-
-      // move the thread to the running state
-      Sys_SwitchState(it, gmThread::RUNNING);
+      if(block->m_signalled) break;
+      block = block->m_nextBlock;
     }
-    it = nit;
+    GM_ASSERT(block);
+    it->Pop();
+    it->Push(block->m_block);
+
+    // move the thread to the running state
+    Sys_SwitchState(it, gmThread::RUNNING);
   }
 
   //
-  // Execute running threads
+  // Execute running threads, from where the last call ran out of time if it did
   //
-  for(it = m_runningThreads.GetFirst(); m_runningThreads.IsValid(it);)
+  gmuint32 start = (a_maxMicros) ? GM_MICROSECONDS() : 0;
+
+  it = (m_nextThread && m_runningThreads.IsValid(m_nextThread)) ? m_nextThread : m_runningThreads.GetFirst();
+  while(m_runningThreads.IsValid(it))
   {
     m_nextThread = m_runningThreads.GetNext(it);
-    it->Sys_Execute();
+    it->Sys_Execute(NULL, m_threadBudget);
     it = m_nextThread;
+
+    if(a_maxMicros && m_runningThreads.IsValid(it) && (gmuint32) (GM_MICROSECONDS() - start) >= a_maxMicros)
+    {
+      break;
+    }
+  }
+
+  int numDeferred = 0;
+  if(m_runningThreads.IsValid(it))
+  {
+    // out of time, m_nextThread is kept for the next call, Sys_SwitchState() moves it on if it stops running
+    for(; m_runningThreads.IsValid(it); it = m_runningThreads.GetNext(it)) ++numDeferred;
+  }
+  else
+  {
+    m_nextThread = NULL;
+  }
+  if(a_numDeferred) *a_numDeferred = numDeferred;
+
+  if((gmint32) (m_time - m_trimTime) >= 0)
+  {
+    Sys_TrimFreeThreads();
   }
 
   CollectGarbage();
@@ -1179,6 +1382,7 @@ bool gmMachine::CollectGarbage(bool a_forceFullCollect)
     // iterate over all threads and mark the stacks.
     for(tit = m_runningThreads.GetFirst(); m_runningThreads.IsValid(tit); tit = m_runningThreads.GetNext(tit)) tit->Mark(m_mark);
     for(tit = m_blockedThreads.GetFirst(); m_blockedThreads.IsValid(tit); tit = m_blockedThreads.GetNext(tit)) tit->Mark(m_mark);
+    for(tit = m_pendingThreads.GetFirst(); m_pendingThreads.IsValid(tit); tit = m_pendingThreads.GetNext(tit)) tit->Mark(m_mark);
     for(tit = m_sleepingThreads.GetFirst(); m_sleepingThreads.IsValid(tit); tit = m_sleepingThreads.GetNext(tit)) tit->Mark(m_mark);
     for(tit = m_exceptionThreads.GetFirst(); m_exceptionThreads.IsValid(tit); tit = m_exceptionThreads.GetNext(tit)) tit->Mark(m_mark);
 
@@ -1240,13 +1444,13 @@ unsigned int gmMachine::GetSystemMemUsed() const
   total += m_memTableObj.GetSystemMemUsed();
   total += m_memFunctionObj.GetSystemMemUsed();
   total += m_memUserObj.GetSystemMemUsed();
-  total += m_memStackFrames.GetSystemMemUsed();
   total += m_fixedSet.GetSystemMemUsed();
 
   // threads
   gmThread * tit;
   for(tit = m_runningThreads.GetFirst(); m_runningThreads.IsValid(tit); tit = m_runningThreads.GetNext(tit)) total += tit->GetSystemMemUsed();
   for(tit = m_blockedThreads.GetFirst(); m_blockedThreads.IsValid(tit); tit = m_blockedThreads.GetNext(tit)) total += tit->GetSystemMemUsed();
+  for(tit = m_pendingThreads.GetFirst(); m_pendingThreads.IsValid(tit); tit = m_pendingThreads.GetNext(tit)) total += tit->GetSystemMemUsed();
   for(tit = m_sleepingThreads.GetFirst(); m_sleepingThreads.IsValid(tit); tit = m_sleepingThreads.GetNext(tit)) total += tit->GetSystemMemUsed();
   for(tit = m_killedThreads.GetFirst(); m_killedThreads.IsValid(tit); tit = m_killedThreads.GetNext(tit)) total += tit->GetSystemMemUsed();
   for(tit = m_exceptionThreads.GetFirst(); m_exceptionThreads.IsValid(tit); tit = m_exceptionThreads.GetNext(tit)) total += tit->GetSystemMemUsed();
@@ -1522,6 +1726,8 @@ void gmMachine::ResetDefaultTypes()
   gmInitBasicType(GM_STRING, m_types[GM_STRING].m_nativeOperators);
   gmInitBasicType(GM_TABLE, m_types[GM_TABLE].m_nativeOperators);
   gmInitBasicType(GM_FUNCTION, m_types[GM_FUNCTION].m_nativeOperators);
+  m_defaultNumberOperators = true;
+  m_defaultTableOperators = true;
 }
 
 
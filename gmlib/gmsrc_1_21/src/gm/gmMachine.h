@@ -68,11 +68,12 @@ class gmStringObject;
 class gmUserObject;
 class gmMachine;
 class gmThread;
-struct gmStackFrame;
 struct gmSignal;
 class gmSourceEntry;
 class gmStream;
 class gmBlockList;
+class gmCodeTree;
+class gmCodeGen;
 
 enum gmMachineCommand
 {
@@ -199,6 +200,16 @@ public:
   /// \brief GetTypeNativeOperator() will lookup a type for a native operator
   inline gmOperatorFunction GetTypeNativeOperator(gmType a_type, gmOperator a_operator);
 
+  /// \brief HasDefaultNumberOperators() returns true while no native int or float operator has been replaced with
+  ///        RegisterTypeOperator().  gmThread evaluates int and float operators inline while this holds, so replace
+  ///        them before running scripts.
+  inline bool HasDefaultNumberOperators() const { return m_defaultNumberOperators; }
+
+  /// \brief HasDefaultTableOperators() returns true while the native table getdot and setdot operators have not been
+  ///        replaced with RegisterTypeOperator().  gmThread reads and writes table members through its member caches
+  ///        while this holds.
+  inline bool HasDefaultTableOperators() const { return m_defaultTableOperators; }
+
   /// \brief GetTypeNativeOperator() will lookup a type for a native operator
   inline gmFunctionObject * GetTypeOperator(gmType a_type, gmOperator a_operator);
 
@@ -231,8 +242,9 @@ public:
   /// \param a_threadId is set to the id of the thread and may be NULL.
   /// \param a_now is true, and execution will occur immediataly, and not at the next Execute() call.
   /// \param a_filename is the filename the lib came from for debugging purposes.
+  /// \param a_lazy is true to load each function on its first call, see gmLibHooks::BindLib().
   /// \return false on lib error
-  bool ExecuteLib(gmStream &a_stream, int * a_threadId = NULL, bool a_now = true, const char * a_filename = NULL, gmVariable* a_this = NULL);
+  bool ExecuteLib(gmStream &a_stream, int * a_threadId = NULL, bool a_now = true, const char * a_filename = NULL, gmVariable* a_this = NULL, bool a_lazy = false);
 
   /// \brief ExecuteFunction() will execute a thread on the passed function
   bool ExecuteFunction(gmFunctionObject * a_function, int * a_threadId = NULL, bool a_now = true, const char * a_filename = NULL, gmVariable* a_this = NULL);
@@ -240,9 +252,10 @@ public:
   /// \brief CompileStringToLib() will compile a_string to byte code suitable for storage in a file.
   /// \param a_string is null terminated script string.
   /// \param a_stream is the file stream to compile the lib to
+  /// \param a_compressSource is true to store the debug source code compressed.
   /// \return the number of errors from compiling the script.
   /// \sa GetCompileLog()
-  int CompileStringToLib(const char * a_string, gmStream &a_stream);
+  int CompileStringToLib(const char * a_string, gmStream &a_stream, bool a_compressSource = false);
 
   /// \brief CompileStringToFunction()
   gmFunctionObject * CompileStringToFunction(const char * a_string, int *a_errorCount = NULL, const char * a_filename = NULL);
@@ -288,11 +301,37 @@ public:
   /// \brief KillExceptionThreads()
   void KillExceptionThreads();
 
-  /// \brief Execute() will execute all running threads
+  /// \brief Execute() will execute all running threads.  After an ExecuteBudget() ran out of time, the threads it
+  ///        left are run first, ahead of threads earlier in the running list.
   /// \param m_deltaTime is the time in milliseconds since the machine was last updated.
   /// \return number of running sleeping and blocked threads.
   int Execute(gmuint32 a_delta);
 
+  /// \brief ExecuteBudget() is Execute(), but stops running threads once a_maxMicros microseconds of wall clock time
+  ///        are spent.  The next ExecuteBudget() or Execute() carries on from the first thread not run, and threads
+  ///        woken meanwhile join the end of the queue, so every running thread gets its turn before any runs twice.
+  ///        A thread is not interrupted for time, see SetThreadBudget() to bound how long a single thread runs.
+  /// \param a_maxMicros is the time budget for running threads, 0 for no limit.  Waking threads and garbage
+  ///        collection are not counted.
+  /// \param a_numDeferred if not NULL, is set to the number of running threads left for the next call.
+  /// \return number of running sleeping and blocked threads.
+  int ExecuteBudget(gmuint32 a_delta, gmuint32 a_maxMicros, int * a_numDeferred = NULL);
+
+  /// \brief SetThreadBudget() will limit how long each thread may run in one Execute().  The budget counts backward
+  ///        branches and calls, so it bounds loops and recursion.  A thread that uses it up is preempted as if it had
+  ///        yielded, and carries on in the next Execute().  0, the default, is no limit.  Threads run outside
+  ///        Execute(), such as by ExecuteString() or gmCallScript, are never preempted.
+  inline void SetThreadBudget(int a_budget) { m_threadBudget = a_budget; }
+  inline int GetThreadBudget() const { return m_threadBudget; }
+
+  /// \brief SetMaxFreeThreads() will set how many dead threads are kept for reuse by new threads.  They keep the stack
+  ///        and call frames they grew, so a reused thread seldom grows them again.  Execute() trims free threads that
+  ///        went unused for GMMACHINE_THREADTRIMTIME, so a burst of threads does not hold on to memory.  The default
+  ///        is GMMACHINE_MAXKILLEDTHREADS.
+  void SetMaxFreeThreads(int a_maxFreeThreads);
+  inline int GetMaxFreeThreads() const { return m_maxFreeThreads; }
+  inline int GetNumFreeThreads() const { return m_numFreeThreads; }
+
   /// \brief GetTime() will return the machine time in milliseconds.
   inline gmuint32 GetTime() const { return m_time; }
 
@@ -453,14 +492,13 @@ public:
   //
   //
 
-  inline gmStackFrame * Sys_AllocStackFrame() { return (gmStackFrame *) m_memStackFrames.Alloc(); }
-  inline void Sys_FreeStackFrame(gmStackFrame * a_frame) { m_memStackFrames.Free(a_frame); }
   void Sys_FreeUniqueString(const char * a_string);
   inline void * Sys_Alloc(int a_size);
   inline void Sys_Free(void * a_mem) { m_fixedSet.Free(a_mem); }
 
   void Sys_RemoveBlocks(gmThread * a_thread);
   void Sys_RemoveSignals(gmThread * a_thread);
+  void Sys_SignalBlock(gmBlock * a_block, const gmVariable &a_signal, int a_dstThreadId, int a_srcThreadId);
 
 #if GM_USE_INCGC
   static void GM_CDECL ScanRootsCallBack(gmMachine* a_machine, gmGarbageCollector* a_gc);
@@ -473,6 +511,13 @@ public:
   inline int GetStatsGCNumFullCollects()          { return m_statsGCFullCollect; }
   inline int GetStatsGCNumIncCollects()           { return m_statsGCIncCollect; }
   inline int GetStatsGCNumWarnings()              { return m_statsGCWarnings; }
+  inline gmuint32 GetStatsGlobalCacheHits()       { return m_statsGlobalCacheHits; }
+  inline gmuint32 GetStatsGlobalCacheMisses()     { return m_statsGlobalCacheMisses; }
+  inline gmuint32 GetStatsThreadsCreated()        { return m_statsThreadsCreated; }
+  inline gmuint32 GetStatsThreadsReused()         { return m_statsThreadsReused; }
+
+  inline void Sys_GlobalCacheHit()                { ++m_statsGlobalCacheHits; }
+  inline void Sys_GlobalCacheMiss()               { ++m_statsGlobalCacheMisses; }
 
 private:
 
@@ -480,13 +525,27 @@ private:
   int m_threadId; // cycling thread number
   gmListDouble<gmThread> m_runningThreads;
   gmListDouble<gmThread> m_blockedThreads;
-  gmListDouble<gmThread> m_sleepingThreads;       ///< sorted by timez
-  gmListDouble<gmThread> m_killedThreads;
+  gmListDouble<gmThread> m_pendingThreads;        ///< signalled blocked threads, in the order signalled, for Execute() to wake
+  gmListDouble<gmThread> m_sleepingThreads;       ///< in no order, m_sleepHeap orders them
+  gmListDouble<gmThread> m_killedThreads;         ///< free threads for reuse, most recently killed first
   gmListDouble<gmThread> m_exceptionThreads;      ///< dead threads, hanging around for debugging
   gmHash<int, gmThread> m_threads;
   int GetThreadId();
   gmuint32 m_time; // machine time in milliseconds. (gives us 50 days)
-  gmThread * m_nextThread;
+  gmThread * m_nextThread; // next running thread for Execute(), kept between calls when ExecuteBudget() runs out of time
+  int m_threadBudget; // backward branches and calls a thread may run per Execute(), 0 for no limit
+  gmArraySimple<gmThread *> m_sleepHeap; // sleeping threads, a binary heap ordered by time stamp then sleep order
+  gmuint32 m_sleepOrder; // cycling count of threads put to sleep
+  int m_numFreeThreads; // threads in m_killedThreads, which does not count quickly
+  int m_maxFreeThreads; // most threads kept in m_killedThreads
+  int m_freeThreadsLowWater; // fewest free threads since the last trim, as many went unused
+  gmuint32 m_trimTime; // machine time of the next trim
+
+  void Sys_SleepHeapInsert(gmThread * a_thread);
+  void Sys_SleepHeapRemove(gmThread * a_thread);
+  void Sys_SleepHeapUp(int a_index);
+  void Sys_SleepHeapDown(int a_index);
+  void Sys_TrimFreeThreads();
 
   // Objects
   void FreeObject(gmObject * a_obj);              ///< FreeObject() does not Destruct the object.
@@ -499,7 +558,6 @@ private:
   gmMemFixed m_memTableObj;                       ///< memory for Table objects
   gmMemFixed m_memFunctionObj;                    ///< memory for Function objects
   gmMemFixed m_memUserObj;                        ///< memory for User objects
-  gmMemFixed m_memStackFrames;                    ///< memory for stack frame structures
   gmMemFixedSet m_fixedSet;                       ///< string and small variable sized stuff allocator.
 
   // Garbage Collection
@@ -513,6 +571,10 @@ private:
   int m_statsGCFullCollect;                       ///< How many times a full collect has occured
   int m_statsGCIncCollect;                        ///< How many times incremental collect has started
   int m_statsGCWarnings;                          ///< The incGC thinks it is being used inefficiently.  It this number is large and growing rapidly the hard and soft limits may need calibrating.
+  gmuint32 m_statsGlobalCacheHits;                ///< Global gets and sets resolved by their inline cache, see GMFUNCTION_GLOBALCACHE
+  gmuint32 m_statsGlobalCacheMisses;              ///< Global gets and sets that had to look up the global table
+  gmuint32 m_statsThreadsCreated;                 ///< Threads allocated by CreateThread()
+  gmuint32 m_statsThreadsReused;                  ///< Threads CreateThread() took from the free thread list
 
   // String Table
   gmHash<const char *, gmStringObject> m_strings;
@@ -545,14 +607,21 @@ private:
 #endif //GM_USE_INCGC
 
   void ResetDefaultTypes();
+  bool m_defaultNumberOperators; // int and float native operators are still those from gmInitBasicType()
+  bool m_defaultTableOperators; // table getdot and setdot native operators are still those from gmInitBasicType()
 
   // Blocking
-  gmHash<gmVariable, gmBlockList, gmVariable> m_blocks; // current registered blocks.
+  gmHash<gmVariable, gmBlockList, gmVariable> m_blocks; // current registered blocks, a wait list per signal.
 
   // Debugging
   bool m_debug;
   gmListDouble<gmSourceEntry> m_source;
   gmLog m_log;
+
+  // Compiler, owned per machine so machines on different threads may compile at once
+  gmCodeTree * m_codeTree;
+  gmCodeGen * m_codeGen;
+  void AllocCompiler();
 };
 
 //
@@ -164,6 +164,34 @@ static int GM_CDECL gmSysGetStatsGCNumWarnings(gmThread * a_thread)
 }
 
 
+static int GM_CDECL gmSysGetStatsGlobalCacheHits(gmThread * a_thread)
+{
+  a_thread->PushInt((int) a_thread->GetMachine()->GetStatsGlobalCacheHits());
+  return GM_OK;
+}
+
+
+static int GM_CDECL gmSysGetStatsGlobalCacheMisses(gmThread * a_thread)
+{
+  a_thread->PushInt((int) a_thread->GetMachine()->GetStatsGlobalCacheMisses());
+  return GM_OK;
+}
+
+
+static int GM_CDECL gmSysGetStatsThreadsCreated(gmThread * a_thread)
+{
+  a_thread->PushInt((int) a_thread->GetMachine()->GetStatsThreadsCreated());
+  return GM_OK;
+}
+
+
+static int GM_CDECL gmSysGetStatsThreadsReused(gmThread * a_thread)
+{
+  a_thread->PushInt((int) a_thread->GetMachine()->GetStatsThreadsReused());
+  return GM_OK;
+}
+
+
 static int GM_CDECL gmDoString(gmThread * a_thread) // string, now(int), returns thread id, null on error, exception on compile error
 {
   GM_CHECK_NUM_PARAMS(1);
@@ -237,6 +265,20 @@ static int GM_CDECL gmThreadTime(gmThread * a_thread)
 
 
 
+static int GM_CDECL gmThreadPreemptions(gmThread * a_thread) // thread id
+{
+  GM_INT_PARAM(id, 0, a_thread->GetId());
+
+  gmThread * thread = a_thread->GetMachine()->GetThread(id);
+  if(thread)
+  {
+    a_thread->PushInt(thread->GetNumPreemptions());
+  }
+  return GM_OK;
+}
+
+
+
 static int GM_CDECL gmThreadId(gmThread * a_thread) // return thread id
 {
   a_thread->PushInt(a_thread->GetId());
@@ -1008,6 +1050,35 @@ static gmFunctionEntry s_binding[] =
   */
   {"sysGetStatsGCNumWarnings", gmSysGetStatsGCNumWarnings},
 
+  /*gm
+    \function sysGetStatsGlobalCacheHits
+    \brief sysGetStatsGlobalCacheHits Return the number of global gets and sets resolved by their inline cache.
+    \return int Number of global cache hits.
+  */
+  {"sysGetStatsGlobalCacheHits", gmSysGetStatsGlobalCacheHits},
+
+  /*gm
+    \function sysGetStatsGlobalCacheMisses
+    \brief sysGetStatsGlobalCacheMisses Return the number of global gets and sets that looked up the global table.
+    A global that is not set always misses.
+    \return int Number of global cache misses.
+  */
+  {"sysGetStatsGlobalCacheMisses", gmSysGetStatsGlobalCacheMisses},
+
+  /*gm
+    \function sysGetStatsThreadsCreated
+    \brief sysGetStatsThreadsCreated Return the number of threads allocated because the free thread list was empty.
+    \return int Number of threads created.
+  */
+  {"sysGetStatsThreadsCreated", gmSysGetStatsThreadsCreated},
+
+  /*gm
+    \function sysGetStatsThreadsReused
+    \brief sysGetStatsThreadsReused Return the number of threads taken from the free thread list.
+    \return int Number of threads reused.
+  */
+  {"sysGetStatsThreadsReused", gmSysGetStatsThreadsReused},
+
   /*gm
     \function sysTime
     \brief sysTime will return the machine time in milli seconds
@@ -1036,6 +1107,14 @@ static gmFunctionEntry s_binding[] =
     \return int 
   */
   {"threadTime", gmThreadTime},
+  /*gm
+    \function threadPreemptions
+    \brief threadPreemptions will return the number of times a thread ran out of its execution budget, see
+           gmMachine::SetThreadBudget()
+    \param int threadId optional (this thread)
+    \return int, or null if there is no such thread
+  */
+  {"threadPreemptions", gmThreadPreemptions},
   /*gm
     \function threadId
     \brief threadId will return the thread id of the current executing script
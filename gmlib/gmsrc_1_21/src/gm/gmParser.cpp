@@ -64,7 +64,7 @@
 #include "gmCodeTree.h"
 #define YYSTYPE gmCodeTreeNode *
 
-extern gmCodeTreeNode * g_codeTree;
+extern GM_THREAD_LOCAL gmCodeTreeNode * g_codeTree;
 
 #define GM_BISON_DEBUG
 #ifdef GM_BISON_DEBUG
@@ -81,12 +81,18 @@ void ATTACH(gmCodeTreeNode * &a_res, gmCodeTreeNode * a_a, gmCodeTreeNode * a_b)
   YYSTYPE t = a_a;
   if(t != NULL)
   {
+    // lists grow at the end, so resume the walk from the last attach point
+    if(a_a->m_lastSibling != NULL)
+    {
+      t = a_a->m_lastSibling;
+    }
     while(t->m_sibling != NULL)
     {
       t = t->m_sibling;
     }
     t->m_sibling = a_b;
     if(a_b) { a_b->m_parent = t; }
+    a_a->m_lastSibling = t;
     a_res = a_a;
   }
   else
@@ -625,8 +631,8 @@ while (0)
 
 #ifndef YYPURE
 
-int	yychar;			/*  the lookahead symbol		*/
-YYSTYPE	yylval;			/*  the semantic value of the		*/
+GM_THREAD_LOCAL int	yychar;			/*  the lookahead symbol		*/
+GM_THREAD_LOCAL YYSTYPE	yylval;			/*  the semantic value of the		*/
 				/*  lookahead symbol			*/
 
 #ifdef YYLSP_NEEDED
@@ -634,11 +640,11 @@ YYLTYPE yylloc;			/*  location data for the lookahead	*/
 				/*  symbol				*/
 #endif
 
-int yynerrs;			/*  number of parse errors so far       */
+GM_THREAD_LOCAL int yynerrs;			/*  number of parse errors so far       */
 #endif  /* not YYPURE */
 
 #if YYDEBUG != 0
-int yydebug;			/*  nonzero means print parse trace	*/
+GM_THREAD_LOCAL int yydebug;			/*  nonzero means print parse trace	*/
 /* Since this is uninitialized, it does not stop multiple parsers
    from coexisting.  */
 #endif
@@ -48,4 +48,4 @@
 #define	TOKEN_ERROR	302
 
 
-extern YYSTYPE gmlval;
+extern GM_THREAD_LOCAL YYSTYPE gmlval;
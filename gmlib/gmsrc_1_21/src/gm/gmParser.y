@@ -16,7 +16,7 @@
 #include "gmCodeTree.h"
 #define YYSTYPE gmCodeTreeNode *
 
-extern gmCodeTreeNode * g_codeTree;
+extern GM_THREAD_LOCAL gmCodeTreeNode * g_codeTree;
 
 #define GM_BISON_DEBUG
 #ifdef GM_BISON_DEBUG
@@ -33,12 +33,18 @@ void ATTACH(gmCodeTreeNode * &a_res, gmCodeTreeNode * a_a, gmCodeTreeNode * a_b)
   YYSTYPE t = a_a;
   if(t != NULL)
   {
+    // lists grow at the end, so resume the walk from the last attach point
+    if(a_a->m_lastSibling != NULL)
+    {
+      t = a_a->m_lastSibling;
+    }
     while(t->m_sibling != NULL)
     {
       t = t->m_sibling;
     }
     t->m_sibling = a_b;
     if(a_b) { a_b->m_parent = t; }
+    a_a->m_lastSibling = t;
     a_res = a_a;
   }
   else
@@ -30,6 +30,7 @@
 #define YY_NEVER_INTERACTIVE 1
 
 #include <stdio.h>
+#include "gmConfig.h"
 
 
 #ifdef __cplusplus
@@ -110,8 +111,8 @@
 
 typedef struct yy_buffer_state *YY_BUFFER_STATE;
 
-extern int yyleng;
-extern FILE *yyin, *yyout;
+extern GM_THREAD_LOCAL int yyleng;
+extern GM_THREAD_LOCAL FILE *yyin, *yyout;
 
 #define EOB_ACT_CONTINUE_SCAN 0
 #define EOB_ACT_END_OF_FILE 1
@@ -209,7 +210,7 @@ struct yy_buffer_state
 #define YY_BUFFER_EOF_PENDING 2
 	};
 
-static YY_BUFFER_STATE yy_current_buffer = 0;
+static GM_THREAD_LOCAL YY_BUFFER_STATE yy_current_buffer = 0;
 
 /* We provide macros for accessing buffer states in case in the
  * future we want to put the buffer states in a more general
@@ -219,22 +220,22 @@ static YY_BUFFER_STATE yy_current_buffer = 0;
 
 
 /* yy_hold_char holds the character lost when yytext is formed. */
-static char yy_hold_char;
+static GM_THREAD_LOCAL char yy_hold_char;
 
-static int yy_n_chars;		/* number of characters read into yy_ch_buf */
+static GM_THREAD_LOCAL int yy_n_chars;		/* number of characters read into yy_ch_buf */
 
 
-int yyleng;
+GM_THREAD_LOCAL int yyleng;
 
 /* Points to current character in buffer. */
-static char *yy_c_buf_p = (char *) 0;
-static int yy_init = 1;		/* whether we need to initialize */
-static int yy_start = 0;	/* start state number */
+static GM_THREAD_LOCAL char *yy_c_buf_p = (char *) 0;
+static GM_THREAD_LOCAL int yy_init = 1;		/* whether we need to initialize */
+static GM_THREAD_LOCAL int yy_start = 0;	/* start state number */
 
 /* Flag which is used to allow yywrap()'s to do buffer switches
  * instead of setting up a fresh yyin.  A bit of a hack ...
  */
-static int yy_did_buffer_switch_on_eof;
+static GM_THREAD_LOCAL int yy_did_buffer_switch_on_eof;
 
 void yyrestart YY_PROTO(( FILE *input_file ));
 
@@ -275,11 +276,11 @@ static void yy_flex_free YY_PROTO(( void * ));
 
 #define YY_USES_REJECT
 typedef unsigned char YY_CHAR;
-FILE *yyin = (FILE *) 0, *yyout = (FILE *) 0;
+GM_THREAD_LOCAL FILE *yyin = (FILE *) 0, *yyout = (FILE *) 0;
 typedef int yy_state_type;
-extern int yylineno;
-int yylineno = 1;
-extern char *yytext;
+extern GM_THREAD_LOCAL int yylineno;
+GM_THREAD_LOCAL int yylineno = 1;
+extern GM_THREAD_LOCAL char *yytext;
 #define yytext_ptr yytext
 
 static yy_state_type yy_get_previous_state YY_PROTO(( void ));
@@ -533,9 +534,10 @@ static yyconst short int yy_chk[352] =
       183
     } ;
 
-static yy_state_type yy_state_buf[YY_BUF_SIZE + 2], *yy_state_ptr;
-static char *yy_full_match;
-static int yy_lp;
+static GM_THREAD_LOCAL yy_state_type yy_state_buf[YY_BUF_SIZE + 2];
+static GM_THREAD_LOCAL yy_state_type *yy_state_ptr;
+static GM_THREAD_LOCAL char *yy_full_match;
+static GM_THREAD_LOCAL int yy_lp;
 #define REJECT \
 { \
 *yy_cp = yy_hold_char; /* undo effects of setting up yytext */ \
@@ -545,7 +547,7 @@ goto find_rule; \
 }
 #define yymore() yymore_used_but_not_detected
 #define YY_MORE_ADJ 0
-char *yytext;
+GM_THREAD_LOCAL char *yytext;
 #line 1 "gmScanner.l"
 #define INITIAL 0
 /*
@@ -595,9 +597,9 @@ static int input YY_PROTO(( void ));
 #endif
 
 #if YY_STACK_USED
-static int yy_start_stack_ptr = 0;
-static int yy_start_stack_depth = 0;
-static int *yy_start_stack = 0;
+static GM_THREAD_LOCAL int yy_start_stack_ptr = 0;
+static GM_THREAD_LOCAL int yy_start_stack_depth = 0;
+static GM_THREAD_LOCAL int *yy_start_stack = 0;
 #ifndef YY_NO_PUSH_STATE
 static void yy_push_state YY_PROTO(( int new_state ));
 #endif
@@ -25,8 +25,8 @@ YY_BUFFER_STATE gm_scan_string(const char * str);
 YY_BUFFER_STATE gm_scan_bytes(const char *bytes, int len);
 void gm_delete_buffer(YY_BUFFER_STATE b);
 int gmlex();
-extern char * gmtext;
-extern int gmlineno;
+extern GM_THREAD_LOCAL char * gmtext;
+extern GM_THREAD_LOCAL int gmlineno;
 
 #endif // _GMSCANNER_H_
 
@@ -11,3 +11,45 @@
 
 #include "gmConfig.h"
 #include "gmStream.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GMSTREAM_SWAP_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GMSTREAM_SWAP_SSE2
+#endif
+
+
+void gmStream::SwapEndian32(void* a_dest, const void* a_src, unsigned int a_count)
+{
+    gmuint32* dest = (gmuint32*)a_dest;
+    const gmuint32* src = (const gmuint32*)a_src;
+    unsigned int i = 0;
+
+#if defined(GMSTREAM_SWAP_AVX2)
+    const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (; i + 8 <= a_count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dest + i), _mm256_shuffle_epi8(v, mask));
+    }
+#elif defined(GMSTREAM_SWAP_SSE2)
+    for (; i + 4 <= a_count; i += 4)
+    {
+        // swap the bytes of each 16 bit half, then swap the halves
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128((__m128i*)(dest + i), v);
+    }
+#endif
+
+    for (; i < a_count; i++)
+    {
+        gmuint32 x = src[i];
+        dest[i] = (x << 24) | ((x << 8) & 0x00ff0000) | ((x >> 8) & 0x0000ff00) | ((x >> 24) & 0x000000ff);
+    }
+}
@@ -61,9 +61,18 @@ public:
     /// \return the number of bytes successfully written
     virtual unsigned int Write(const void* p_buffer, unsigned int p_n, bool p_swap = false) = 0;
 
+    /// \brief ReadDirect() will return a pointer to the next p_n bytes and move past them, without copying or
+    ///        swapping.  Only memory backed streams support this.
+    /// \return NULL if not supported or fewer than p_n bytes remain, in which case the cursor is unchanged.
+    virtual const void* ReadDirect(unsigned int p_n) { return NULL; }
+
     /// \brief GetFlags() will return the current stream flags
     inline Flags GetFlags() const { return (Flags)m_flags; }
 
+    /// \brief SwapEndian32() will copy a_count 32 bit words from a_src to a_dest, swapping the endian of each.
+    ///        a_dest may equal a_src to swap in place.  Uses SSE2 or AVX2 when the compiler targets them.
+    static void SwapEndian32(void* a_dest, const void* a_src, unsigned int a_count);
+
     //
     // Streaming interface (quite slow, but helpful...)
     //
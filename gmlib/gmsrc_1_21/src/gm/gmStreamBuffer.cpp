@@ -63,15 +63,16 @@ unsigned int gmStreamBufferStatic::Read(void* p_buffer, unsigned int p_n, bool p
         m_flags |= F_EOS;
         p_n = remain;
     }
-    memcpy(p_buffer, &m_stream[m_cursor], p_n);
-
     // swap hack
     if (p_swap && GetSwapEndianOnWrite())
     {
-        for (unsigned int i = 0; i < p_n / sizeof(gmuint32); i++)
-        {
-            SwapEndian(((gmuint32*)p_buffer)[i]);
-        }
+        unsigned int words = p_n / sizeof(gmuint32);
+        SwapEndian32(p_buffer, &m_stream[m_cursor], words);
+        memcpy((char*)p_buffer + words * sizeof(gmuint32), &m_stream[m_cursor + words * sizeof(gmuint32)], p_n - words * sizeof(gmuint32));
+    }
+    else
+    {
+        memcpy(p_buffer, &m_stream[m_cursor], p_n);
     }
 
     m_cursor += p_n;
@@ -86,6 +87,18 @@ unsigned int gmStreamBufferStatic::Write(const void* p_buffer, unsigned int p_n,
 }
 
 
+const void* gmStreamBufferStatic::ReadDirect(unsigned int p_n)
+{
+    if (p_n > m_size - m_cursor)
+    {
+        return NULL;
+    }
+    const void* data = &m_stream[m_cursor];
+    m_cursor += p_n;
+    return data;
+}
+
+
 void gmStreamBufferStatic::Open(const void* p_buffer, unsigned int a_size)
 {
     m_cursor = 0;
@@ -146,15 +159,16 @@ unsigned int gmStreamBufferDynamic::Read(void* p_buffer, unsigned int p_n, bool
         m_flags |= F_EOS;
         p_n = remain;
     }
-    memcpy(p_buffer, m_stream.GetData() + m_cursor, p_n);
-
     // swap hack
     if (p_swap && GetSwapEndianOnWrite())
     {
-        for (unsigned int i = 0; i < p_n / sizeof(gmuint32); i++)
-        {
-            SwapEndian(((gmuint32*)p_buffer)[i]);
-        }
+        unsigned int words = p_n / sizeof(gmuint32);
+        SwapEndian32(p_buffer, m_stream.GetData() + m_cursor, words);
+        memcpy((char*)p_buffer + words * sizeof(gmuint32), m_stream.GetData() + m_cursor + words * sizeof(gmuint32), p_n - words * sizeof(gmuint32));
+    }
+    else
+    {
+        memcpy(p_buffer, m_stream.GetData() + m_cursor, p_n);
     }
 
     m_cursor += p_n;
@@ -170,15 +184,16 @@ unsigned int gmStreamBufferDynamic::Write(const void* p_buffer, unsigned int p_n
         // grow the stream
         m_stream.SetCount(m_cursor + p_n);
     }
-    memcpy(m_stream.GetData() + m_cursor, p_buffer, p_n);
-
     // swap hack
     if (p_swap && GetSwapEndianOnWrite())
     {
-        for (unsigned int i = 0; i < p_n / sizeof(gmuint32); i++)
-        {
-            SwapEndian(((gmuint32*)(m_stream.GetData() + m_cursor))[i]);
-        }
+        unsigned int words = p_n / sizeof(gmuint32);
+        SwapEndian32(m_stream.GetData() + m_cursor, p_buffer, words);
+        memcpy(m_stream.GetData() + m_cursor + words * sizeof(gmuint32), (const char*)p_buffer + words * sizeof(gmuint32), p_n - words * sizeof(gmuint32));
+    }
+    else
+    {
+        memcpy(m_stream.GetData() + m_cursor, p_buffer, p_n);
     }
 
     m_cursor += p_n;
@@ -186,6 +201,18 @@ unsigned int gmStreamBufferDynamic::Write(const void* p_buffer, unsigned int p_n
 }
 
 
+const void* gmStreamBufferDynamic::ReadDirect(unsigned int p_n)
+{
+    if (p_n > m_stream.Count() - m_cursor)
+    {
+        return NULL;
+    }
+    const void* data = m_stream.GetData() + m_cursor;
+    m_cursor += p_n;
+    return data;
+}
+
+
 void gmStreamBufferDynamic::Reset()
 {
     m_cursor = 0;
@@ -31,6 +31,7 @@ public:
     virtual unsigned int GetSize() const;
     virtual unsigned int Read(void* p_buffer, unsigned int p_n, bool p_swap = false);
     virtual unsigned int Write(const void* p_buffer, unsigned int p_n, bool p_swap = false);
+    virtual const void* ReadDirect(unsigned int p_n);
 
     void Open(const void* a_buffer, unsigned int a_size);
     inline const char* GetData() const { return m_stream; }
@@ -57,6 +58,7 @@ public:
     virtual unsigned int GetSize() const;
     virtual unsigned int Read(void* p_buffer, unsigned int p_n, bool p_swap = false);
     virtual unsigned int Write(const void* p_buffer, unsigned int p_n, bool p_swap = false);
+    virtual const void* ReadDirect(unsigned int p_n);
 
     void Reset();
     void ResetAndFreeMemory();
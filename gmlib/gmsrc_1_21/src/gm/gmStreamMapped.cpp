@@ -0,0 +1,125 @@
+/*
+    _____               __  ___          __            ____        _      __
+   / ___/__ ___ _  ___ /  |/  /__  ___  / /_____ __ __/ __/_______(_)__  / /_
+  / (_ / _ `/  ' \/ -_) /|_/ / _ \/ _ \/  '_/ -_) // /\ \/ __/ __/ / _ \/ __/
+  \___/\_,_/_/_/_/\__/_/  /_/\___/_//_/_/\_\\__/\_, /___/\__/_/ /_/ .__/\__/
+                                               /___/             /_/
+
+  See Copyright Notice in gmMachine.h
+
+*/
+
+#include "gmConfig.h"
+#include "gmStreamMapped.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else // _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif // _WIN32
+
+
+gmStreamMapped::gmStreamMapped()
+{
+    m_mapping = NULL;
+    m_mappingSize = 0;
+#ifdef _WIN32
+    m_file = INVALID_HANDLE_VALUE;
+    m_map = NULL;
+#endif // _WIN32
+}
+
+
+gmStreamMapped::~gmStreamMapped()
+{
+    Close();
+}
+
+
+bool gmStreamMapped::Open(const char* a_filename)
+{
+    Close();
+
+#ifdef _WIN32
+    m_file = CreateFileA(a_filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size) || size.HighPart != 0)
+    {
+        Close();
+        return false;
+    }
+    m_mappingSize = size.LowPart;
+
+    // empty files can not be mapped
+    if (m_mappingSize)
+    {
+        m_map = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        m_mapping = (m_map) ? MapViewOfFile(m_map, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (m_mapping == NULL)
+        {
+            Close();
+            return false;
+        }
+    }
+#else // _WIN32
+    int file = open(a_filename, O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || (unsigned long long)info.st_size > 0xffffffffull)
+    {
+        close(file);
+        return false;
+    }
+    m_mappingSize = (unsigned int)info.st_size;
+
+    // empty files can not be mapped
+    if (m_mappingSize)
+    {
+        m_mapping = mmap(NULL, m_mappingSize, PROT_READ, MAP_PRIVATE, file, 0);
+        if (m_mapping == MAP_FAILED)
+        {
+            m_mapping = NULL;
+            close(file);
+            Close();
+            return false;
+        }
+    }
+
+    // the mapping keeps the file referenced
+    close(file);
+#endif // _WIN32
+
+    gmStreamBufferStatic::Open(m_mapping, m_mappingSize);
+    return true;
+}
+
+
+void gmStreamMapped::Close()
+{
+#ifdef _WIN32
+    if (m_mapping) UnmapViewOfFile(m_mapping);
+    if (m_map) CloseHandle(m_map);
+    if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+    m_map = NULL;
+    m_file = INVALID_HANDLE_VALUE;
+#else // _WIN32
+    if (m_mapping) munmap(m_mapping, m_mappingSize);
+#endif // _WIN32
+
+    m_mapping = NULL;
+    m_mappingSize = 0;
+    gmStreamBufferStatic::Open(NULL, 0);
+}
@@ -0,0 +1,46 @@
+/*
+    _____               __  ___          __            ____        _      __
+   / ___/__ ___ _  ___ /  |/  /__  ___  / /_____ __ __/ __/_______(_)__  / /_
+  / (_ / _ `/  ' \/ -_) /|_/ / _ \/ _ \/  '_/ -_) // /\ \/ __/ __/ / _ \/ __/
+  \___/\_,_/_/_/_/\__/_/  /_/\___/_//_/_/\_\\__/\_, /___/\__/_/ /_/ .__/\__/
+                                               /___/             /_/
+
+  See Copyright Notice in gmMachine.h
+
+*/
+
+#ifndef _GMSTREAMMAPPED_H_
+#define _GMSTREAMMAPPED_H_
+
+#include "gmConfig.h"
+#include "gmStreamBuffer.h"
+
+/// \class gmStreamMapped
+/// \brief gmStreamMapped is a read only stream over a memory mapped file.  ReadDirect() hands out pointers
+///        into the mapping, which stay valid until Close().
+class gmStreamMapped : public gmStreamBufferStatic
+{
+public:
+
+    gmStreamMapped();
+    virtual ~gmStreamMapped();
+
+    /// \brief Open() will map the whole of the named file.
+    /// \return false if the file could not be opened or mapped.
+    bool Open(const char* a_filename);
+
+    /// \brief Close() will unmap the file.
+    void Close();
+
+private:
+
+    void* m_mapping;
+    unsigned int m_mappingSize;
+#ifdef _WIN32
+    void* m_file;
+    void* m_map;
+#endif // _WIN32
+};
+
+
+#endif // _GMSTREAMMAPPED_H_
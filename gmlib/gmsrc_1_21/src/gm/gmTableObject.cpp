@@ -21,6 +21,7 @@ gmTableObject::gmTableObject()
   m_firstFree = NULL;
   m_tableSize = 0;
   m_slotsUsed = 0;
+  m_version = 1;
 }
 
 
@@ -90,6 +91,7 @@ void gmTableObject::Destruct(gmMachine * a_machine)
   {
     a_machine->Sys_Free(m_nodes);
     m_nodes = NULL;
+    NodesChanged();
   }
 
   m_firstFree = NULL;
@@ -103,24 +105,49 @@ void gmTableObject::Destruct(gmMachine * a_machine)
 
 
 
-gmVariable gmTableObject::Get(const gmVariable &a_key) const
+gmTableNode * gmTableObject::GetNode(const gmVariable &a_key) const
 {
-  gmTableNode* foundNode = NULL;
-
   if(m_nodes && a_key.m_type != GM_NULL)
   {
-    foundNode = GetAtHashPos(&a_key);
+    gmTableNode * foundNode = GetAtHashPos(&a_key);
 
     do
     {
       if(a_key.m_value.m_ref == foundNode->m_key.m_value.m_ref &&
          a_key.m_type == foundNode->m_key.m_type)
       {
-        return foundNode->m_value;
+        return foundNode;
       }
       foundNode = foundNode->m_nextInHashTable;
     } while (foundNode);
-  }  
+  }
+  return NULL;
+}
+
+
+gmTableNode * gmTableObject::CacheNode(gmTableMemberCache &a_cache) const
+{
+  gmTableNode * foundNode = GetNode(gmVariable(GM_STRING, a_cache.m_key));
+  if(foundNode)
+  {
+    int way;
+    for(way = gmTableMemberCache::NUM_WAYS - 1; way > 0; --way)
+    {
+      a_cache.m_index[way] = a_cache.m_index[way - 1];
+    }
+    a_cache.m_index[0] = (int) (foundNode - m_nodes);
+  }
+  return foundNode;
+}
+
+
+gmVariable gmTableObject::Get(const gmVariable &a_key) const
+{
+  gmTableNode * foundNode = GetNode(a_key);
+  if(foundNode)
+  {
+    return foundNode->m_value;
+  }
 
   gmVariable null;
   null.Nullify();
@@ -188,6 +215,7 @@ void gmTableObject::Set(gmMachine * a_machine, const gmVariable &a_key, const gm
           foundNode->m_key.m_type = GM_NULL;
         }
         --m_slotsUsed;
+        NodesChanged();
         return;
       }
       foundNode->m_value = a_value;
@@ -217,6 +245,7 @@ void gmTableObject::Set(gmMachine * a_machine, const gmVariable &a_key, const gm
       other->m_nextInHashTable = m_firstFree;
       *m_firstFree = *origHashNode; //Copy colliding node into free pos
       origHashNode->m_nextInHashTable = NULL; //original is now completely free
+      NodesChanged();
     }
     else
     {
@@ -392,6 +421,7 @@ void gmTableObject::AllocSize(gmMachine * a_machine, int a_size)
   m_nodes = (gmTableNode*)a_machine->Sys_Alloc(memSize);
   m_tableSize = a_size;
   m_slotsUsed = 0;
+  NodesChanged();
 
   memset(m_nodes, 0, memSize);
   m_firstFree = &m_nodes[m_tableSize-1];
@@ -28,6 +28,30 @@ struct gmTableNode
 };
 
 
+/// \struct gmTableCache
+/// \brief gmTableCache is an inline cache of a table lookup.  m_node holds m_key while the table version equals
+///        m_version, a version of 0 is never valid.
+struct gmTableCache
+{
+  gmTableNode * m_node;
+  gmuint32 m_version;
+  gmptr m_key;                                    ///< string key
+};
+
+
+/// \struct gmTableMemberCache
+/// \brief gmTableMemberCache is an inline cache of a string key's node index in recently seen tables.  an index is
+///        checked against the node's key before use, so it is shared by all tables with the same layout and needs
+///        no invalidation.
+struct gmTableMemberCache
+{
+  enum { NUM_WAYS = 2 };
+
+  gmptr m_key;                                    ///< string key
+  int m_index[NUM_WAYS];                          ///< node indices, most recent first, -1 for none
+};
+
+
 /// \class gmTable
 /// \brief
 class gmTableObject : public gmObject
@@ -68,6 +92,31 @@ public:
   inline int Count() const { return m_slotsUsed; }
   gmTableObject * Duplicate(gmMachine * a_machine);
 
+  /// \brief GetNode() will return the node holding a_key, or NULL if the key is not in the table.  the node stays
+  ///        valid while GetVersion() is unchanged.
+  gmTableNode * GetNode(const gmVariable &a_key) const;
+
+  /// \brief GetVersion() changes whenever nodes are moved, removed or reallocated.  it is never 0.
+  inline gmuint32 GetVersion() const { return m_version; }
+
+  /// \brief GetNode() will return the node holding the key of a_cache, or NULL if the key is not in the table.
+  ///        a_cache is updated on a miss.
+  inline gmTableNode * GetNode(gmTableMemberCache &a_cache) const
+  {
+    int way;
+    for(way = 0; way < gmTableMemberCache::NUM_WAYS; ++way)
+    {
+      unsigned int index = (unsigned int) a_cache.m_index[way];
+      if(index < (unsigned int) m_tableSize &&
+         m_nodes[index].m_key.m_value.m_ref == a_cache.m_key &&
+         m_nodes[index].m_key.m_type == GM_STRING)
+      {
+        return &m_nodes[index];
+      }
+    }
+    return CacheNode(a_cache);
+  }
+
 
   //
   // iterator
@@ -117,13 +166,16 @@ private:
   }
 
 
+  gmTableNode * CacheNode(gmTableMemberCache &a_cache) const;
   void Resize(gmMachine * a_machine);
   void AllocSize(gmMachine * a_machine, int a_size);
+  inline void NodesChanged() { if(++m_version == 0) m_version = 1; }
 
   gmTableNode * m_nodes;
   gmTableNode * m_firstFree;
   int m_tableSize;
   int m_slotsUsed;
+  gmuint32 m_version;
 };
 
 #endif // _GMTABLEOBJECT_H_
\ No newline at end of file
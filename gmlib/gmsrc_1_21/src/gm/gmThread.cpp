@@ -16,17 +16,165 @@
 #include "gmFunctionObject.h"
 #include "gmOperators.h"
 #include "gmMachineLib.h"
+#include <math.h>
 
 // helper macros
 
-#define OPCODE_PTR(I)  *((gmptr *) (I)); (I) += sizeof(gmptr);
-#define OPCODE_PTR_NI(I)  *((gmptr *) I);
-#define OPCODE_FLOAT(I)  *((gmfloat *) I); I += sizeof(gmfloat);
+#define OPCODE_PTR(I)  gmReadPtr(I); (I) += sizeof(gmptr);
+#define OPCODE_FLOAT(I)  gmReadFloat(I); I += sizeof(gmfloat);
+#define OPCODE_MEMBERCACHE(I)  (gmTableMemberCache *) (code + gmReadPtr(I)); (I) += sizeof(gmptr);
+#define OPCODE_BYTE(I)  *((I)++);
 #define OPERATOR(TYPE, OPERATOR) (m_machine->GetTypeNativeOperator((TYPE), (OPERATOR)))
 #define CALLOPERATOR(TYPE, OPERATOR) (m_machine->GetTypeOperator((TYPE), (OPERATOR)))
 #define GMTHREAD_LOG m_machine->GetLog().LogEntry
 #define PUSHNULL top->m_type = GM_NULL; top->m_value.m_int = 0; ++top;
 
+// take a branch, a backward one uses up the execution budget
+#define GMTHREAD_BRANCH(TARGET) \
+  { \
+    const gmuint8 * target = (TARGET); \
+    if(target <= instruction && --budget == 0 && a_budget) { instruction = target; goto preempt; } \
+    instruction = target; \
+  }
+
+// compact byte code operands are not aligned
+static inline gmptr gmReadPtr(const gmuint8 * a_operand)
+{
+  gmptr value;
+  memcpy(&value, a_operand, sizeof(gmptr));
+  return value;
+}
+
+static inline gmfloat gmReadFloat(const gmuint8 * a_operand)
+{
+  gmfloat value;
+  memcpy(&value, a_operand, sizeof(gmfloat));
+  return value;
+}
+
+//
+// Byte code dispatch. With GMTHREAD_THREADEDDISPATCH every handler ends in its own indirect jump through
+// a table of label addresses (gcc and clang labels as values), so each jump is predicted on its own
+// instead of all instructions sharing the switch's one jump.  Unknown byte codes are skipped, as by the switch.
+//
+
+#if GMTHREAD_THREADEDDISPATCH
+
+#if !defined(__GNUC__)
+#error GMTHREAD_THREADEDDISPATCH needs a compiler with labels as values
+#endif // !__GNUC__
+
+#define GMTHREAD_CASE(BC) label_##BC :
+#define GMTHREAD_DEFAULT label_default :
+#define GMTHREAD_NEXT goto *s_dispatch[gmDispatchIndex(*(instruction++))]
+#define GMTHREAD_SWITCH GMTHREAD_NEXT;
+#define GMTHREAD_DISPATCH_TABLE \
+  static const void * const s_dispatch[BC_NUMBYTECODES + 1] = \
+  { \
+    &&label_BC_GETDOT, &&label_BC_SETDOT, &&label_BC_GETIND, &&label_BC_SETIND, \
+    &&label_BC_OP_ADD, &&label_BC_OP_SUB, &&label_BC_OP_MUL, &&label_BC_OP_DIV, &&label_BC_OP_REM, \
+    &&label_BC_BIT_OR, &&label_BC_BIT_XOR, &&label_BC_BIT_AND, &&label_BC_BIT_SHL, &&label_BC_BIT_SHR, &&label_BC_BIT_INV, \
+    &&label_BC_OP_LT, &&label_BC_OP_GT, &&label_BC_OP_LTE, &&label_BC_OP_GTE, &&label_BC_OP_EQ, &&label_BC_OP_NEQ, \
+    &&label_BC_OP_NEG, &&label_BC_OP_POS, &&label_BC_OP_NOT, \
+    &&label_BC_NOP, &&label_BC_LINE, \
+    &&label_BC_BRA, &&label_BC_BRZ, &&label_BC_BRNZ, &&label_BC_BRZK, &&label_BC_BRNZK, \
+    &&label_BC_CALL, &&label_BC_RET, &&label_BC_RETV, &&label_BC_FOREACH, \
+    &&label_BC_POP, &&label_BC_POP2, &&label_BC_DUP, &&label_BC_DUP2, &&label_BC_SWAP, \
+    &&label_BC_PUSHNULL, &&label_BC_PUSHINT, &&label_BC_PUSHINT0, &&label_BC_PUSHINT1, &&label_BC_PUSHFP, \
+    &&label_BC_PUSHSTR, &&label_BC_PUSHTBL, &&label_BC_PUSHFN, &&label_BC_PUSHTHIS, \
+    &&label_BC_GETLOCAL, &&label_BC_SETLOCAL, &&label_BC_GETGLOBAL, &&label_BC_SETGLOBAL, \
+    &&label_BC_GETTHIS, &&label_BC_SETTHIS, \
+    &&label_BC_GETLOCAL8, &&label_BC_SETLOCAL8, &&label_BC_CALL8, &&label_BC_PUSHINT8, \
+    &&label_BC_GETLOCAL_GETLOCAL_ADD, &&label_BC_GETLOCAL_GETLOCAL_LT_BRZ, &&label_BC_GETLOCAL_PUSHINT_LT_BRZ, \
+    &&label_BC_PUSHINT1_ADD_SETLOCAL, &&label_BC_GETTHIS_GETDOT, \
+    &&label_BC_GETLOCAL_OP, &&label_BC_PUSHINT_OP, &&label_BC_GETLOCAL_PUSHINT_OP, \
+    &&label_default, \
+  };
+
+// one entry per byte code plus the default, in gmByteCode order
+typedef char gmDispatchTableCheck[(BC_GETLOCAL_PUSHINT_OP + 1 == BC_NUMBYTECODES) ? 1 : -1];
+
+static inline gmuint32 gmDispatchIndex(gmuint32 a_byteCode)
+{
+  return (a_byteCode < BC_NUMBYTECODES) ? a_byteCode : BC_NUMBYTECODES;
+}
+
+#else // !GMTHREAD_THREADEDDISPATCH
+
+#define GMTHREAD_CASE(BC) case BC :
+#define GMTHREAD_DEFAULT default :
+#define GMTHREAD_NEXT break
+#define GMTHREAD_SWITCH switch(*(instruction++))
+#define GMTHREAD_DISPATCH_TABLE
+
+#endif // !GMTHREAD_THREADEDDISPATCH
+
+//
+// Int and float operators are evaluated inline, the same as the gmOperators.cpp functions would, while the
+// machine still has its default number operators.  Other operands go through the operator tables.  The machine
+// is checked as Sys_Execute() starts, so a running thread sees replaced operators from its next time slice.
+//
+
+#define GMTHREAD_INTS(A) ((A)[0].m_type == GM_INT && (A)[1].m_type == GM_INT && numberOperators)
+#define GMTHREAD_NUMBERS(A) ((gmuint) ((A)[0].m_type - GM_INT) <= 1 && (gmuint) ((A)[1].m_type - GM_INT) <= 1 && numberOperators)
+#define GMTHREAD_TOFLOAT(A) (((A)->m_type == GM_FLOAT) ? (A)->m_value.m_float : (gmfloat) (A)->m_value.m_int)
+
+// int op int is int, otherwise float
+#define GMTHREAD_ARITHMETIC(BC, OP) \
+      GMTHREAD_CASE(BC) \
+      { \
+        operand = top - 2; \
+        if(GMTHREAD_INTS(operand)) { operand->m_value.m_int = operand->m_value.m_int OP operand[1].m_value.m_int; --top; GMTHREAD_NEXT; } \
+        if(GMTHREAD_NUMBERS(operand)) { operand->m_value.m_float = GMTHREAD_TOFLOAT(operand) OP GMTHREAD_TOFLOAT(operand + 1); operand->m_type = GM_FLOAT; --top; GMTHREAD_NEXT; } \
+        goto binaryOperator; \
+      }
+
+// int only
+#define GMTHREAD_BITWISE(BC, OP) \
+      GMTHREAD_CASE(BC) \
+      { \
+        operand = top - 2; \
+        if(GMTHREAD_INTS(operand)) { operand->m_value.m_int = operand->m_value.m_int OP operand[1].m_value.m_int; --top; GMTHREAD_NEXT; } \
+        goto binaryOperator; \
+      }
+
+// int result
+#define GMTHREAD_COMPARE(BC, OP) \
+      GMTHREAD_CASE(BC) \
+      { \
+        operand = top - 2; \
+        if(GMTHREAD_INTS(operand)) { operand->m_value.m_int = (operand->m_value.m_int OP operand[1].m_value.m_int); --top; GMTHREAD_NEXT; } \
+        if(GMTHREAD_NUMBERS(operand)) { operand->m_value.m_int = (GMTHREAD_TOFLOAT(operand) OP GMTHREAD_TOFLOAT(operand + 1)); operand->m_type = GM_INT; --top; GMTHREAD_NEXT; } \
+        goto binaryOperator; \
+      }
+
+// int operators of the register operand superinstructions, as inline above.  a_byteCode is one gmByteCodeFuse() allows
+static inline int gmThreadIntOperator(gmuint32 a_byteCode, int a_a, int a_b)
+{
+  switch(a_byteCode)
+  {
+    case BC_OP_ADD : return a_a + a_b;
+    case BC_OP_SUB : return a_a - a_b;
+    case BC_OP_MUL : return a_a * a_b;
+    case BC_OP_DIV : return a_a / a_b;
+    case BC_OP_REM : return a_a % a_b;
+    case BC_BIT_OR : return a_a | a_b;
+    case BC_BIT_XOR : return a_a ^ a_b;
+    case BC_BIT_AND : return a_a & a_b;
+    case BC_BIT_SHL : return a_a << a_b;
+    case BC_BIT_SHR : return a_a >> a_b;
+    case BC_OP_LT : return a_a < a_b;
+    case BC_OP_GT : return a_a > a_b;
+    case BC_OP_LTE : return a_a <= a_b;
+    case BC_OP_GTE : return a_a >= a_b;
+    case BC_OP_EQ : return a_a == a_b;
+    case BC_OP_NEQ : return a_a != a_b;
+    default : break;
+  }
+  GM_ASSERT(false);
+  return 0;
+}
+
 // helper functions
 void gmGetLineFromString(const char * a_string, int a_line, char * a_buffer, int a_len)
 {
@@ -60,6 +208,8 @@ gmThread::gmThread(gmMachine * a_machine, int a_initialByteSize)
   m_machine = a_machine;
   m_size = a_initialByteSize / sizeof(gmVariable);
   m_stack = new gmVariable[m_size];
+  m_maxFrames = GMTHREAD_INITIALFRAMES;
+  m_frames = new gmStackFrame[m_maxFrames];
   m_top = 0;
   m_base = 0;
   m_numParameters = 0;
@@ -69,7 +219,10 @@ gmThread::gmThread(gmMachine * a_machine, int a_initialByteSize)
 #endif // GMDEBUG_SUPPORT
 
   m_timeStamp = 0;
+  m_sleepOrder = 0;
+  m_sleepIndex = -1;
   m_startTime = 0;
+  m_numPreemptions = 0;
   m_instruction = NULL;
   m_state = KILLED;
   m_id = GM_INVALID_THREAD;
@@ -88,6 +241,10 @@ gmThread::~gmThread()
   {
     delete [] m_stack;
   }
+  if(m_frames)
+  {
+    delete [] m_frames;
+  }
 }
 
 
@@ -170,13 +327,9 @@ void gmThread::Mark(gmuint32 a_mark)
 #endif //GM_USE_INCGC
 
 // RAGE AGAINST THE VIRTUAL MACHINE =)
-gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
+gmThread::State gmThread::Sys_Execute(gmVariable * a_return, int a_budget)
 {
-  register union
-  {
-    const gmuint8 * instruction;
-    const gmuint32 * instruction32;
-  };
+  register const gmuint8 * instruction;
   register gmVariable * top;
   gmVariable * base;
   gmVariable * operand;
@@ -205,30 +358,46 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
   else instruction = m_instruction;
   top = GetTop();
   base = GetBase();
+  gmuint32 budget = a_budget; // without a budget it wraps, and runs out harmlessly every 2^32 branches
+  const bool numberOperators = m_machine->HasDefaultNumberOperators();
+  const bool tableOperators = m_machine->HasDefaultTableOperators();
 
   //
   // start byte code execution
   //
+  GMTHREAD_DISPATCH_TABLE
   for(;;)
   {
-    switch(*(instruction32++))
+    GMTHREAD_SWITCH
     {
       //
       // unary operator
       //
 
-      case BC_BIT_INV :
-      case BC_OP_NEG :
-      case BC_OP_POS :
-      case BC_OP_NOT :
+      GMTHREAD_CASE(BC_OP_NEG)
+      {
+        operand = top - 1;
+        if(operand->m_type == GM_INT && numberOperators) { operand->m_value.m_int = -operand->m_value.m_int; GMTHREAD_NEXT; }
+        if(operand->m_type == GM_FLOAT && numberOperators) { operand->m_value.m_float = -operand->m_value.m_float; GMTHREAD_NEXT; }
+        goto unaryOperator;
+      }
+      GMTHREAD_CASE(BC_OP_NOT)
+      {
+        operand = top - 1;
+        if(operand->m_type == GM_INT && numberOperators) { operand->m_value.m_int = !operand->m_value.m_int; GMTHREAD_NEXT; }
+        goto unaryOperator;
+      }
+      GMTHREAD_CASE(BC_BIT_INV)
+      GMTHREAD_CASE(BC_OP_POS)
+unaryOperator:
       {
         operand = top - 1; 
-        gmOperatorFunction op = OPERATOR(operand->m_type, (gmOperator) instruction32[-1]); 
+        gmOperatorFunction op = OPERATOR(operand->m_type, (gmOperator) instruction[-1]); 
         if(op) 
         { 
           op(this, operand); 
         } 
-        else if((fn = CALLOPERATOR(operand->m_type, (gmOperator) instruction32[-1]))) 
+        else if((fn = CALLOPERATOR(operand->m_type, (gmOperator) instruction[-1]))) 
         { 
           operand[2] = operand[0]; 
           operand[0] = gmVariable(GM_NULL, 0); 
@@ -237,7 +406,7 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
           State res = PushStackFrame(1, &instruction, &code); 
           top = GetTop();
           base = GetBase();
-          if(res == RUNNING) break;
+          if(res == RUNNING) GMTHREAD_NEXT;
           if(res == SYS_YIELD) return RUNNING;
           if(res == SYS_EXCEPTION) goto exception;
           if(res == KILLED) { m_machine->Sys_SwitchState(this, KILLED); GM_ASSERT(0); } // operator should not kill a thread
@@ -245,43 +414,50 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
         } 
         else 
         { 
-          GMTHREAD_LOG("unary operator %s undefined for type %s", gmGetOperatorName((gmOperator) instruction32[-1]), m_machine->GetTypeName(operand->m_type)); 
+          GMTHREAD_LOG("unary operator %s undefined for type %s", gmGetOperatorName((gmOperator) instruction[-1]), m_machine->GetTypeName(operand->m_type)); 
           goto exception; 
         } 
-        break;
+        GMTHREAD_NEXT;
       }
 
       //
       // operator
       //
 
-      case BC_OP_ADD :
-      case BC_OP_SUB :
-      case BC_OP_MUL :
-      case BC_OP_DIV :
-      case BC_OP_REM :
-      case BC_BIT_OR :
-      case BC_BIT_XOR :
-      case BC_BIT_AND :
-      case BC_BIT_SHL :
-      case BC_BIT_SHR :
-      case BC_OP_LT :
-      case BC_OP_GT :
-      case BC_OP_LTE :
-      case BC_OP_GTE :
-      case BC_OP_EQ :
-      case BC_OP_NEQ :
+      GMTHREAD_ARITHMETIC(BC_OP_ADD, +)
+      GMTHREAD_ARITHMETIC(BC_OP_SUB, -)
+      GMTHREAD_ARITHMETIC(BC_OP_MUL, *)
+      GMTHREAD_ARITHMETIC(BC_OP_DIV, /)
+      GMTHREAD_BITWISE(BC_BIT_OR, |)
+      GMTHREAD_BITWISE(BC_BIT_XOR, ^)
+      GMTHREAD_BITWISE(BC_BIT_AND, &)
+      GMTHREAD_BITWISE(BC_BIT_SHL, <<)
+      GMTHREAD_BITWISE(BC_BIT_SHR, >>)
+      GMTHREAD_COMPARE(BC_OP_LT, <)
+      GMTHREAD_COMPARE(BC_OP_GT, >)
+      GMTHREAD_COMPARE(BC_OP_LTE, <=)
+      GMTHREAD_COMPARE(BC_OP_GTE, >=)
+      GMTHREAD_COMPARE(BC_OP_EQ, ==)
+      GMTHREAD_COMPARE(BC_OP_NEQ, !=)
+      GMTHREAD_CASE(BC_OP_REM)
+      {
+        operand = top - 2;
+        if(GMTHREAD_INTS(operand)) { operand->m_value.m_int %= operand[1].m_value.m_int; --top; GMTHREAD_NEXT; }
+        if(GMTHREAD_NUMBERS(operand)) { operand->m_value.m_float = fmodf(GMTHREAD_TOFLOAT(operand), GMTHREAD_TOFLOAT(operand + 1)); operand->m_type = GM_FLOAT; --top; GMTHREAD_NEXT; }
+        goto binaryOperator;
+      }
+binaryOperator:
       {
         operand = top - 2; 
         --top; 
         register gmType t1 = operand[1].m_type; 
         if(operand->m_type > t1) t1 = operand->m_type; 
-        gmOperatorFunction op = OPERATOR(t1, (gmOperator) instruction32[-1]); 
+        gmOperatorFunction op = OPERATOR(t1, (gmOperator) instruction[-1]); 
         if(op) 
         { 
           op(this, operand); 
         } 
-        else if((fn = CALLOPERATOR(t1, (gmOperator) instruction32[-1]))) 
+        else if((fn = CALLOPERATOR(t1, (gmOperator) instruction[-1]))) 
         { 
           operand[2] = operand[0]; 
           operand[3] = operand[1]; 
@@ -291,7 +467,7 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
           State res = PushStackFrame(2, &instruction, &code); 
           top = GetTop(); 
           base = GetBase();
-          if(res == RUNNING) break;
+          if(res == RUNNING) GMTHREAD_NEXT;
           if(res == SYS_YIELD) return RUNNING;
           if(res == SYS_EXCEPTION) goto exception;
           if(res == KILLED) { m_machine->Sys_SwitchState(this, KILLED); GM_ASSERT(0); } // operator should not kill a thread
@@ -299,17 +475,17 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
         } 
         else 
         { 
-          GMTHREAD_LOG("operator %s undefined for type %s and %s", gmGetOperatorName((gmOperator) instruction32[-1]), m_machine->GetTypeName(operand->m_type), m_machine->GetTypeName((operand + 1)->m_type)); 
+          GMTHREAD_LOG("operator %s undefined for type %s and %s", gmGetOperatorName((gmOperator) instruction[-1]), m_machine->GetTypeName(operand->m_type), m_machine->GetTypeName((operand + 1)->m_type)); 
           goto exception; 
         } 
 
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_NOP :
+      GMTHREAD_CASE(BC_NOP)
       {
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_LINE :
+      GMTHREAD_CASE(BC_LINE)
       {
 
 #if GMDEBUG_SUPPORT
@@ -323,12 +499,23 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
 
 #endif // GMDEBUG_SUPPORT
 
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_GETDOT :
+      GMTHREAD_CASE(BC_GETDOT)
+getDot:
       {
         operand = top - 1;
+#if GMFUNCTION_MEMBERCACHE
+        gmTableMemberCache * cache = OPCODE_MEMBERCACHE(instruction);
+        gmptr member = cache->m_key;
+        if(operand->m_type == GM_TABLE && tableOperators)
+        {
+          gmTableNode * node = ((gmTableObject *) GM_MOBJECT(m_machine, operand->m_value.m_ref))->GetNode(*cache);
+          if(node && node->m_value.m_type != GM_NULL) { *operand = node->m_value; GMTHREAD_NEXT; }
+        }
+#else // GMFUNCTION_MEMBERCACHE
         gmptr member = OPCODE_PTR(instruction);
+#endif // GMFUNCTION_MEMBERCACHE
         top->m_type = GM_STRING;
         top->m_value.m_ref = member;
         gmType t1 = operand->m_type;
@@ -336,7 +523,7 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
         if(op)
         {
           op(this, operand);
-          if(operand->m_type) break;
+          if(operand->m_type) GMTHREAD_NEXT;
         }
         if(t1 == GM_NULL)
         {
@@ -344,12 +531,23 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
           goto exception;
         }
         *operand = m_machine->GetTypeVariable(t1, gmVariable(GM_STRING, member));
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_SETDOT :
+      GMTHREAD_CASE(BC_SETDOT)
       {
         operand = top - 2;
+#if GMFUNCTION_MEMBERCACHE
+        gmTableMemberCache * cache = OPCODE_MEMBERCACHE(instruction);
+        gmptr member = cache->m_key;
+        // setting null removes the member, leave that to the table
+        if(operand->m_type == GM_TABLE && tableOperators && operand[1].m_type != GM_NULL)
+        {
+          gmTableNode * node = ((gmTableObject *) GM_MOBJECT(m_machine, operand->m_value.m_ref))->GetNode(*cache);
+          if(node) { node->m_value = operand[1]; top -= 2; GMTHREAD_NEXT; }
+        }
+#else // GMFUNCTION_MEMBERCACHE
         gmptr member = OPCODE_PTR(instruction);
+#endif // GMFUNCTION_MEMBERCACHE
         top->m_type = GM_STRING;
         top->m_value.m_ref = member;
         top -= 2;
@@ -363,9 +561,9 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
           GMTHREAD_LOG("setdot failed.");
           goto exception;
         }
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_GETIND :
+      GMTHREAD_CASE(BC_GETIND)
       {
         operand = top - 2;
         --top;
@@ -379,9 +577,9 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
           GMTHREAD_LOG("getind failed.");
           goto exception;
         }
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_SETIND :
+      GMTHREAD_CASE(BC_SETIND)
       {
         operand = top - 3;
         top -= 3;
@@ -395,56 +593,59 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
           GMTHREAD_LOG("setind failed.");
           goto exception;
         }
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_BRA :
+      GMTHREAD_CASE(BC_BRA)
       {
-        instruction = code + OPCODE_PTR_NI(instruction);
-        break;
+        GMTHREAD_BRANCH(code + gmReadPtr(instruction));
+        GMTHREAD_NEXT;
       }
-      case BC_BRZ :
+      GMTHREAD_CASE(BC_BRZ)
       {
         --top;
         if(top->m_value.m_int == 0)
         {
-          instruction = code + OPCODE_PTR_NI(instruction);
+          GMTHREAD_BRANCH(code + gmReadPtr(instruction));
         }
         else instruction += sizeof(gmptr);
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_BRNZ :
+      GMTHREAD_CASE(BC_BRNZ)
       {
         --top;
         if(top->m_value.m_int != 0)
         {
-          instruction = code + OPCODE_PTR_NI(instruction);
+          GMTHREAD_BRANCH(code + gmReadPtr(instruction));
         }
         else instruction += sizeof(gmptr);
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_BRZK :
+      GMTHREAD_CASE(BC_BRZK)
       {
         if(top[-1].m_value.m_int == 0)
         {
-          instruction = code + OPCODE_PTR_NI(instruction);
+          GMTHREAD_BRANCH(code + gmReadPtr(instruction));
         }
         else instruction += sizeof(gmptr);
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_BRNZK :
+      GMTHREAD_CASE(BC_BRNZK)
       {
         if(top[-1].m_value.m_int != 0)
         {
-          instruction = code + OPCODE_PTR_NI(instruction);
+          GMTHREAD_BRANCH(code + gmReadPtr(instruction));
         }
         else instruction += sizeof(gmptr);
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_CALL :
+      GMTHREAD_CASE(BC_CALL)
+      GMTHREAD_CASE(BC_CALL8)
       {
         SetTop(top);
         
-        int numParams = (int) OPCODE_PTR(instruction);
+        int numParams;
+        if(instruction[-1] == BC_CALL8) { numParams = OPCODE_BYTE(instruction); }
+        else { numParams = (int) OPCODE_PTR(instruction); }
 
         State res = PushStackFrame(numParams, &instruction, &code);
         top = GetTop(); 
@@ -463,7 +664,8 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
 
 #endif // GMDEBUG_SUPPORT
 
-          break;
+          if(--budget == 0 && a_budget) goto preempt;
+          GMTHREAD_NEXT;
         }
         if(res == SYS_YIELD) return RUNNING;
         if(res == SYS_EXCEPTION) goto exception;
@@ -474,11 +676,11 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
         }
         return res;
       }
-      case BC_RET :
+      GMTHREAD_CASE(BC_RET)
       {
         PUSHNULL;
       }
-      case BC_RETV :
+      GMTHREAD_CASE(BC_RETV)
       {
         SetTop(top);
         int res = Sys_PopStackFrame(instruction, code);
@@ -498,7 +700,7 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
 
 #endif // GMDEBUG_SUPPORT
 
-          break;
+          GMTHREAD_NEXT;
         }
         if(res == KILLED)
         {
@@ -507,9 +709,9 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
           return KILLED;
         }
         if(res == SYS_EXCEPTION) goto exception;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_FOREACH :
+      GMTHREAD_CASE(BC_FOREACH)
       {
         gmuint32 localvalue = OPCODE_PTR(instruction);
         gmuint32 localkey = localvalue >> 16;
@@ -537,129 +739,211 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
           top->m_type = GM_INT; top->m_value.m_int = 0;
         }
         ++top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_POP :
+      GMTHREAD_CASE(BC_POP)
       {
         --top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_POP2 :
+      GMTHREAD_CASE(BC_POP2)
       {
         top -= 2;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_DUP :
+      GMTHREAD_CASE(BC_DUP)
       {
         top[0] = top[-1]; 
         ++top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_DUP2 :
+      GMTHREAD_CASE(BC_DUP2)
       {
         top[0] = top[-2];
         top[1] = top[-1];
         top += 2;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_SWAP :
+      GMTHREAD_CASE(BC_SWAP)
       {
         top[0] = top[-1];
         top[-1] = top[-2];
         top[-2] = top[0];
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_PUSHNULL :
+      GMTHREAD_CASE(BC_PUSHNULL)
       {
         PUSHNULL;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_PUSHINT :
+      GMTHREAD_CASE(BC_PUSHINT)
       {
         top->m_type = GM_INT;
         top->m_value.m_int = OPCODE_PTR(instruction);
         ++top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_PUSHINT0 :
+      GMTHREAD_CASE(BC_PUSHINT8)
+      {
+        top->m_type = GM_INT;
+        top->m_value.m_int = (signed char) OPCODE_BYTE(instruction);
+        ++top;
+        GMTHREAD_NEXT;
+      }
+      GMTHREAD_CASE(BC_PUSHINT0)
       {
         top->m_type = GM_INT;
         top->m_value.m_int = 0;
         ++top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_PUSHINT1 :
+      GMTHREAD_CASE(BC_PUSHINT1)
       {
         top->m_type = GM_INT;
         top->m_value.m_int = 1;
         ++top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_PUSHFP :
+      GMTHREAD_CASE(BC_PUSHFP)
       {
         top->m_type = GM_FLOAT;
         top->m_value.m_float = OPCODE_FLOAT(instruction);
         ++top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_PUSHSTR :
+      GMTHREAD_CASE(BC_PUSHSTR)
       {
         top->m_type = GM_STRING;
         top->m_value.m_ref = OPCODE_PTR(instruction);
         ++top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_PUSHTBL :
+      GMTHREAD_CASE(BC_PUSHTBL)
       {
         SetTop(top);
         top->m_type = GM_TABLE;
         top->m_value.m_ref = m_machine->AllocTableObject()->GetRef();
         ++top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_PUSHFN :
+      GMTHREAD_CASE(BC_PUSHFN)
       {
         top->m_type = GM_FUNCTION;
         top->m_value.m_ref = OPCODE_PTR(instruction);
         ++top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_PUSHTHIS :
+      GMTHREAD_CASE(BC_PUSHTHIS)
       {
         *top = *GetThis();
         ++top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_GETLOCAL :
+      GMTHREAD_CASE(BC_GETLOCAL)
       {
         gmuint32 offset = OPCODE_PTR(instruction);
         *(top++) = base[offset];
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_SETLOCAL :
+      GMTHREAD_CASE(BC_SETLOCAL)
       {
         gmuint32 offset = OPCODE_PTR(instruction);
         base[offset] = *(--top);
-        break;
+        GMTHREAD_NEXT;
+      }
+      GMTHREAD_CASE(BC_GETLOCAL8)
+      {
+        gmuint32 offset = OPCODE_BYTE(instruction);
+        *(top++) = base[offset];
+        GMTHREAD_NEXT;
+      }
+      GMTHREAD_CASE(BC_SETLOCAL8)
+      {
+        gmuint32 offset = OPCODE_BYTE(instruction);
+        base[offset] = *(--top);
+        GMTHREAD_NEXT;
+      }
+#if GMFUNCTION_GLOBALCACHE
+      GMTHREAD_CASE(BC_GETGLOBAL)
+      {
+        gmptr cacheOffset = OPCODE_PTR(instruction);
+        gmTableCache * cache = (gmTableCache *) (code + cacheOffset);
+        gmTableObject * globals = m_machine->GetGlobals();
+        if(cache->m_version == globals->GetVersion())
+        {
+          m_machine->Sys_GlobalCacheHit();
+          *(top++) = cache->m_node->m_value;
+          GMTHREAD_NEXT;
+        }
+        m_machine->Sys_GlobalCacheMiss();
+        top->m_type = GM_STRING;
+        top->m_value.m_ref = cache->m_key;
+        gmTableNode * node = globals->GetNode(*top);
+        if(node)
+        {
+          cache->m_node = node;
+          cache->m_version = globals->GetVersion();
+          *top = node->m_value;
+        }
+        else top->Nullify();
+        ++top;
+        GMTHREAD_NEXT;
+      }
+      GMTHREAD_CASE(BC_SETGLOBAL)
+      {
+        gmptr cacheOffset = OPCODE_PTR(instruction);
+        gmTableCache * cache = (gmTableCache *) (code + cacheOffset);
+        gmTableObject * globals = m_machine->GetGlobals();
+        // setting null removes the global, leave that to the table
+        if(cache->m_version == globals->GetVersion() && (top-1)->m_type != GM_NULL)
+        {
+          m_machine->Sys_GlobalCacheHit();
+          cache->m_node->m_value = *(--top);
+          GMTHREAD_NEXT;
+        }
+        m_machine->Sys_GlobalCacheMiss();
+        top->m_type = GM_STRING;
+        top->m_value.m_ref = cache->m_key;
+        globals->Set(m_machine, *top, *(top-1));
+        gmTableNode * node = globals->GetNode(*top);
+        if(node)
+        {
+          cache->m_node = node;
+          cache->m_version = globals->GetVersion();
+        }
+        --top;
+        GMTHREAD_NEXT;
       }
-      case BC_GETGLOBAL :
+#else // GMFUNCTION_GLOBALCACHE
+      GMTHREAD_CASE(BC_GETGLOBAL)
       {
         top->m_type = GM_STRING;
         top->m_value.m_ref = OPCODE_PTR(instruction);
         *top = m_machine->GetGlobals()->Get(*top); ++top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_SETGLOBAL :
+      GMTHREAD_CASE(BC_SETGLOBAL)
       {
         top->m_type = GM_STRING;
         top->m_value.m_ref = OPCODE_PTR(instruction);
         m_machine->GetGlobals()->Set(m_machine, *top, *(top-1)); --top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_GETTHIS :
+#endif // GMFUNCTION_GLOBALCACHE
+      GMTHREAD_CASE(BC_GETTHIS)
       {
-        gmptr member = OPCODE_PTR(instruction);
         const gmVariable * thisVar = GetThis();
+#if GMFUNCTION_MEMBERCACHE
+        gmTableMemberCache * cache = OPCODE_MEMBERCACHE(instruction);
+        gmptr member = cache->m_key;
+        if(thisVar->m_type == GM_TABLE && tableOperators)
+        {
+          gmTableNode * node = ((gmTableObject *) GM_MOBJECT(m_machine, thisVar->m_value.m_ref))->GetNode(*cache);
+          if(node && node->m_value.m_type != GM_NULL) { *(top++) = node->m_value; GMTHREAD_NEXT; }
+        }
+#else // GMFUNCTION_MEMBERCACHE
+        gmptr member = OPCODE_PTR(instruction);
+#endif // GMFUNCTION_MEMBERCACHE
         *top = *thisVar;
         top[1].m_type = GM_STRING;
         top[1].m_value.m_ref = member;
@@ -667,7 +951,7 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
         if(op)
         {
           op(this, top);
-          if(top->m_type) { ++top; break; }
+          if(top->m_type) { ++top; GMTHREAD_NEXT; }
         }
         if(thisVar->m_type == GM_NULL)
         {
@@ -676,12 +960,23 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
         }
         *top = m_machine->GetTypeVariable(thisVar->m_type, top[1]);
         ++top;
-        break;
+        GMTHREAD_NEXT;
       }
-      case BC_SETTHIS :
+      GMTHREAD_CASE(BC_SETTHIS)
       {
-        gmptr member = OPCODE_PTR(instruction);
         const gmVariable * thisVar = GetThis();
+#if GMFUNCTION_MEMBERCACHE
+        gmTableMemberCache * cache = OPCODE_MEMBERCACHE(instruction);
+        gmptr member = cache->m_key;
+        // setting null removes the member, leave that to the table
+        if(thisVar->m_type == GM_TABLE && tableOperators && (top - 1)->m_type != GM_NULL)
+        {
+          gmTableNode * node = ((gmTableObject *) GM_MOBJECT(m_machine, thisVar->m_value.m_ref))->GetNode(*cache);
+          if(node) { node->m_value = *(--top); GMTHREAD_NEXT; }
+        }
+#else // GMFUNCTION_MEMBERCACHE
+        gmptr member = OPCODE_PTR(instruction);
+#endif // GMFUNCTION_MEMBERCACHE
         operand = top - 1;
         *top = *operand;
         *operand = *thisVar;
@@ -698,15 +993,194 @@ gmThread::State gmThread::Sys_Execute(gmVariable * a_return)
           GMTHREAD_LOG("setthis failed.");
           goto exception;
         }
-        break;
+        GMTHREAD_NEXT;
+      }
+
+      //
+      // superinstructions, see gmByteCodeFuse().  operands are read from the original sequence, which is still in
+      // place after the superinstruction.  when the common case does not hold they run part of the sequence and
+      // carry on from the original byte code.
+      //
+
+      GMTHREAD_CASE(BC_GETLOCAL_GETLOCAL_ADD)
+      {
+        // get local a, get local b, add
+        const gmVariable * a = base + instruction[0];
+        const gmVariable * b = base + instruction[2];
+        if(a->m_type == GM_INT && b->m_type == GM_INT && numberOperators)
+        {
+          top->m_type = GM_INT;
+          top->m_value.m_int = a->m_value.m_int + b->m_value.m_int;
+          ++top;
+          instruction += 4;
+          GMTHREAD_NEXT;
+        }
+        top[0] = *a;
+        top[1] = *b;
+        top += 2;
+        instruction += 3;
+        GMTHREAD_NEXT;
+      }
+      GMTHREAD_CASE(BC_GETLOCAL_GETLOCAL_LT_BRZ)
+      {
+        // get local a, get local b, lt, brz target
+        const gmVariable * a = base + instruction[0];
+        const gmVariable * b = base + instruction[2];
+        if(a->m_type == GM_INT && b->m_type == GM_INT && numberOperators)
+        {
+          if(a->m_value.m_int < b->m_value.m_int) instruction += 5 + sizeof(gmptr);
+          else GMTHREAD_BRANCH(code + gmReadPtr(instruction + 5));
+          GMTHREAD_NEXT;
+        }
+        top[0] = *a;
+        top[1] = *b;
+        top += 2;
+        instruction += 3;
+        GMTHREAD_NEXT;
+      }
+      GMTHREAD_CASE(BC_GETLOCAL_PUSHINT_LT_BRZ)
+      {
+        // get local a, push int b, lt, brz target.  b is a gmptr or a byte, the push int 8 may have been fused
+        const gmVariable * a = base + instruction[0];
+        int b, length;
+        if(instruction[1] == BC_PUSHINT) { b = (int) gmReadPtr(instruction + 2); length = 2 + sizeof(gmptr); }
+        else { b = (signed char) instruction[2]; length = 3; }
+        if(a->m_type == GM_INT && numberOperators)
+        {
+          if(a->m_value.m_int < b) instruction += length + 2 + sizeof(gmptr);
+          else GMTHREAD_BRANCH(code + gmReadPtr(instruction + length + 2));
+          GMTHREAD_NEXT;
+        }
+        top[0] = *a;
+        top[1].m_type = GM_INT;
+        top[1].m_value.m_int = b;
+        top += 2;
+        instruction += length;
+        GMTHREAD_NEXT;
+      }
+      GMTHREAD_CASE(BC_PUSHINT1_ADD_SETLOCAL)
+      {
+        // push int 1, add, set local a
+        operand = top - 1;
+        if(operand->m_type == GM_INT && numberOperators)
+        {
+          gmVariable * a = base + instruction[2];
+          a->m_type = GM_INT;
+          a->m_value.m_int = operand->m_value.m_int + 1;
+          --top;
+          instruction += 3;
+          GMTHREAD_NEXT;
+        }
+        top->m_type = GM_INT;
+        top->m_value.m_int = 1;
+        ++top;
+        GMTHREAD_NEXT;
+      }
+      GMTHREAD_CASE(BC_GETTHIS_GETDOT)
+      {
+        // get this, then the get dot that follows it, skipping its byte code.  as BC_GETTHIS
+        const gmVariable * thisVar = GetThis();
+#if GMFUNCTION_MEMBERCACHE
+        gmTableMemberCache * cache = OPCODE_MEMBERCACHE(instruction);
+        gmptr member = cache->m_key;
+        if(thisVar->m_type == GM_TABLE && tableOperators)
+        {
+          gmTableNode * node = ((gmTableObject *) GM_MOBJECT(m_machine, thisVar->m_value.m_ref))->GetNode(*cache);
+          if(node && node->m_value.m_type != GM_NULL)
+          {
+            *(top++) = node->m_value;
+            ++instruction;
+            goto getDot;
+          }
+        }
+#else // GMFUNCTION_MEMBERCACHE
+        gmptr member = OPCODE_PTR(instruction);
+#endif // GMFUNCTION_MEMBERCACHE
+        *top = *thisVar;
+        top[1].m_type = GM_STRING;
+        top[1].m_value.m_ref = member;
+        gmOperatorFunction op = OPERATOR(thisVar->m_type, O_GETDOT);
+        if(op)
+        {
+          op(this, top);
+          if(top->m_type) { ++top; ++instruction; goto getDot; }
+        }
+        if(thisVar->m_type == GM_NULL)
+        {
+          GMTHREAD_LOG("getthis failed. this is null");
+          goto exception;
+        }
+        *top = m_machine->GetTypeVariable(thisVar->m_type, top[1]);
+        ++top;
+        ++instruction;
+        goto getDot;
+      }
+      GMTHREAD_CASE(BC_GETLOCAL_OP)
+      {
+        // get local b, op
+        const gmVariable * b = base + instruction[0];
+        operand = top - 1;
+        if(operand->m_type == GM_INT && b->m_type == GM_INT && numberOperators)
+        {
+          operand->m_value.m_int = gmThreadIntOperator(instruction[1], operand->m_value.m_int, b->m_value.m_int);
+          instruction += 2;
+          GMTHREAD_NEXT;
+        }
+        *(top++) = *b;
+        ++instruction;
+        GMTHREAD_NEXT;
+      }
+      GMTHREAD_CASE(BC_PUSHINT_OP)
+      {
+        // push int b, op
+        int b = (signed char) instruction[0];
+        operand = top - 1;
+        if(operand->m_type == GM_INT && numberOperators)
+        {
+          operand->m_value.m_int = gmThreadIntOperator(instruction[1], operand->m_value.m_int, b);
+          instruction += 2;
+          GMTHREAD_NEXT;
+        }
+        top->m_type = GM_INT;
+        top->m_value.m_int = b;
+        ++top;
+        ++instruction;
+        GMTHREAD_NEXT;
       }
-      default :
+      GMTHREAD_CASE(BC_GETLOCAL_PUSHINT_OP)
       {
-        break;
+        // get local a, push int b, op
+        const gmVariable * a = base + instruction[0];
+        if(a->m_type == GM_INT && numberOperators)
+        {
+          top->m_type = GM_INT;
+          top->m_value.m_int = gmThreadIntOperator(instruction[3], a->m_value.m_int, (signed char) instruction[2]);
+          ++top;
+          instruction += 4;
+          GMTHREAD_NEXT;
+        }
+        *(top++) = *a;
+        ++instruction;
+        GMTHREAD_NEXT;
+      }
+      GMTHREAD_DEFAULT
+      {
+        GMTHREAD_NEXT;
       }
     }
   }
 
+preempt:
+
+  //
+  // out of budget, suspend as a yield does and carry on in the next gmMachine::Execute()
+  //
+
+  SetTop(top);
+  m_instruction = instruction;
+  ++m_numPreemptions;
+  return RUNNING;
+
 exception:
 
   //
@@ -748,18 +1222,13 @@ void gmThread::Sys_Reset(int a_id)
   m_machine->Sys_RemoveBlocks(this);
   m_machine->Sys_RemoveSignals(this);
 
-  gmStackFrame * frame;
-  while(m_frame)
-  {
-    frame = m_frame->m_prev;
-    m_machine->Sys_FreeStackFrame(m_frame);
-    m_frame = frame;
-  }
+  m_frame = NULL;
   m_top = 0;
   m_base = 0;
   m_instruction = NULL;
   m_timeStamp = 0;
   m_startTime = 0;
+  m_numPreemptions = 0;
   m_id = a_id;
   m_numParameters = 0;
   m_user = 0;
@@ -858,6 +1327,13 @@ gmThread::State gmThread::PushStackFrame(int a_numParameters, const gmuint8 ** a
   // Its a script function call, push a stack frame
   //
 
+  // functions from lazily bound libs are loaded on their first call
+  if(!fn->IsBound() && !fn->Bind(m_machine))
+  {
+    m_machine->GetLog().LogEntry("could not bind function");
+    return SYS_EXCEPTION;
+  }
+
   int clearSize = fn->GetNumParamsLocals() - a_numParameters;
   if(!Touch(clearSize + fn->GetMaxStackSize())) 
   {
@@ -876,7 +1352,12 @@ gmThread::State gmThread::PushStackFrame(int a_numParameters, const gmuint8 ** a
   }
 
   // push a new stack frame
-  gmStackFrame * frame = m_machine->Sys_AllocStackFrame();
+  gmStackFrame * frame = (m_frame) ? m_frame + 1 : m_frames;
+  if(frame == m_frames + m_maxFrames)
+  {
+    Sys_GrowFrames();
+    frame = m_frame + 1;
+  }
   frame->m_prev = m_frame;
   m_frame = frame;
 
@@ -908,14 +1389,12 @@ gmThread::State gmThread::Sys_PopStackFrame(const gmuint8 * &a_ip, const gmuint8
     m_machine->GetLog().LogEntry("stack underflow");
     return SYS_EXCEPTION;
   }
-  gmStackFrame * frame = m_frame->m_prev;
   a_ip = m_frame->m_returnAddress;
   // copy old tos to new tos
   m_stack[m_base - 2] = m_stack[m_top - 1];
   m_top = m_base - 1;
   m_base = m_frame->m_returnBase;
-  m_machine->Sys_FreeStackFrame(m_frame);
-  m_frame = frame;
+  m_frame = m_frame->m_prev;
   if(m_frame == NULL) 
   {
     return KILLED;
@@ -976,6 +1455,25 @@ bool gmThread::Touch(int a_extra)
 
 
 
+void gmThread::Sys_GrowFrames()
+{
+  int numFrames = (m_frame) ? (int) (m_frame - m_frames) + 1 : 0;
+  gmStackFrame * frames = new gmStackFrame[m_maxFrames * 2];
+  memcpy(frames, m_frames, numFrames * sizeof(gmStackFrame));
+
+  // each frame links to the one below it, which has moved
+  for(int i = 0; i < numFrames; ++i)
+  {
+    frames[i].m_prev = (i) ? &frames[i - 1] : NULL;
+  }
+  delete[] m_frames;
+  m_frames = frames;
+  m_frame = (numFrames) ? &frames[numFrames - 1] : NULL;
+  m_maxFrames *= 2;
+}
+
+
+
 void gmThread::LogCallStack()
 {
   m_machine->GetLog().LogEntry(GM_NL"callstack..");
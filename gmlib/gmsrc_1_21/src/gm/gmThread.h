@@ -31,8 +31,8 @@ struct gmSignal;
 #define GM_INVALID_THREAD 0
 
 /// \struct gmStackFrame
-/// \brief The stack order is as follows: this, fp, p0..pn-1, l0..ln-1.  gmStackFrame objects are allocated from the gmMachine.
-///        Base pointer is at the first parameter.
+/// \brief The stack order is as follows: this, fp, p0..pn-1, l0..ln-1.  gmStackFrame objects are held in a contiguous
+///        array owned by the thread, so calls and returns do not allocate.  Base pointer is at the first parameter.
 struct gmStackFrame
 {
   gmStackFrame * m_prev;
@@ -75,8 +75,10 @@ public:
   /// \brief Sys_Execute() will perform execution on this thread.  a this, function references, params and stack
   ///        frame must be pushed before a call to execute will succeed.
   /// \param a_return will be set to the return variable iff Sys_Execute returns gmThread::KILLED. 
+  /// \param a_budget is the number of backward branches and calls to run before the thread is preempted and
+  ///        returns RUNNING, 0 for no limit.  see gmMachine::SetThreadBudget()
   /// \return the new thread state.
-  State Sys_Execute(gmVariable * a_return = NULL);
+  State Sys_Execute(gmVariable * a_return = NULL, int a_budget = 0);
 
   /// \brief Sys_Reset() will reset the thread.
   void Sys_Reset(int a_id);
@@ -181,11 +183,17 @@ public:
   inline State GetState() const { return m_state; }
   inline gmuint32 GetTimeStamp() const { return m_timeStamp; }
   inline gmuint32 GetThreadTime() const { return m_machine->GetTime() - m_startTime; }
+  /// \brief GetNumPreemptions() will return the number of times this thread ran out of its execution budget.
+  inline gmuint32 GetNumPreemptions() const { return m_numPreemptions; }
   inline void Sys_SetTimeStamp(gmuint32 a_timeStamp) { m_timeStamp = a_timeStamp; }
+  inline int Sys_GetSleepIndex() const { return m_sleepIndex; }
+  inline void Sys_SetSleepIndex(int a_sleepIndex) { m_sleepIndex = a_sleepIndex; }
+  inline gmuint32 Sys_GetSleepOrder() const { return m_sleepOrder; }
+  inline void Sys_SetSleepOrder(gmuint32 a_sleepOrder) { m_sleepOrder = a_sleepOrder; }
   inline void Sys_SetStartTime(gmuint32 a_startTime) { m_startTime = a_startTime; }
 
   /// \brief GetSystemMemUsed will return the number of bytes allocated by the system.
-  inline unsigned int GetSystemMemUsed() const { return (m_size * sizeof(gmVariable)) + sizeof(this); }
+  inline unsigned int GetSystemMemUsed() const { return (m_size * sizeof(gmVariable)) + (m_maxFrames * sizeof(gmStackFrame)) + sizeof(this); }
 
   void LogCallStack();
 
@@ -216,6 +224,9 @@ private:
   /// \return RUNNING, KILLED or SYS_EXCEPTION
   State Sys_PopStackFrame(const gmuint8 * &a_ip, const gmuint8 * &a_cp);
 
+  /// \brief Sys_GrowFrames() will double the frame array, and relink the frames in it.
+  void Sys_GrowFrames();
+
   void LogLineFile();
 
   // stack members
@@ -224,12 +235,17 @@ private:
   int m_size;
   int m_top;
   int m_base;
-  gmStackFrame * m_frame;
+  gmStackFrame * m_frame; // top of m_frames, NULL when empty
+  gmStackFrame * m_frames;
+  int m_maxFrames;
 
   // thread members
   State m_state;
   gmuint32 m_timeStamp; // wake up at this time stamp.
+  gmuint32 m_sleepOrder; // breaks time stamp ties, so threads sleeping until the same time wake in the order they slept.
+  int m_sleepIndex; // position in the machine's sleep heap when SLEEPING.
   gmuint32 m_startTime; // time this thread was started.
+  gmuint32 m_numPreemptions; // times this thread ran out of its execution budget.
   const gmuint8 * m_instruction;
   int m_id;
   gmSignal * m_signals; // list of potentially active signals on this thread.
@@ -3,3 +3,6 @@ flex -ogmScanner.cpp -Pgm -Sflex.skl gmScanner.l
 
 rem use following for verbose bison
 rem bison -o gmParser.cpp -d -l -v -p gm gmParser.y  
+
+rem flex writes the %option yylineno state (yylineno, yytext, yy_state_buf, yy_full_match, yy_lp)
+rem outside flex.skl, so mark those GM_THREAD_LOCAL by hand after regenerating gmScanner.cpp
@@ -15,6 +15,7 @@
 #include <malloc.h>
 #include <new.h>
 #include <alloca.h>
+#include <time.h>
 
 // pragmas
 
@@ -33,6 +34,8 @@
 #define GM_NL                 "\r\n" // "\n"
 #define GM_FORCEINLINE        inline
 #define GM_INLINE             inline
+#define GM_THREAD_LOCAL       // no threaded compiles
+#define GM_MICROSECONDS()     ((gmuint32) ((unsigned long long) clock() * 1000000 / CLOCKS_PER_SEC)) // wrapping monotonic clock
 #define _gmstricmp            strcasecmp
 #define _gmsnprintf           snprintf
 #define _gmvsnprintf          vsnprintf
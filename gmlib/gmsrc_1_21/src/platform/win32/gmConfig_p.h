@@ -14,6 +14,7 @@
 
 #include <malloc.h>
 #include <new.h>
+#include <chrono>
 
 
 // pragmas
@@ -38,6 +39,8 @@
 #define GM_NL                 "\r\n" // "\n"
 #define GM_FORCEINLINE        __forceinline // inline
 #define GM_INLINE             inline
+#define GM_THREAD_LOCAL       __declspec(thread) // compiler state is per thread
+#define GM_MICROSECONDS()     ((gmuint32) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()) // wrapping monotonic clock
 #define _gmstricmp            stricmp // strcasecmp
 #define _gmsnprintf           _snprintf // snprintf
 #define _gmvsnprintf          _vsnprintf // vsnprintf